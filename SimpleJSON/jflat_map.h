@@ -0,0 +1,311 @@
+#pragma once
+
+#include "jkey.h"
+#include <stdint.h>
+#include <functional>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace mq
+{
+
+/*
+ * A map from strings kept as one vector of members in insertion order,
+ * with an open addressing hash table of member indexes for lookups once
+ * it grows past a few members. Members are not allocated one by one and
+ * a lookup hashes the key once instead of walking tree nodes. Keys are
+ * `jkey`s, which keep their hash and may be shared with other maps. It can
+ * stand in for `std::map` as `json::object`, see `MQ_JSON_FLAT_OBJECT`
+ * in json.h, except that iteration follows insertion order. Equality
+ * does not depend on the order. As in `std::map` the keys are const,
+ * changing one through an iterator would break the index.
+ */
+template<class T>
+class jflat_map
+{
+public:
+    using key_type = jkey;
+    using mapped_type = T;
+    using value_type = std::pair<const jkey, T>;
+    using size_type = size_t;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    jflat_map() = default;
+    jflat_map(std::initializer_list<value_type> init)
+    {
+        insert(init.begin(), init.end());
+    }
+    template<class It>
+    jflat_map(It first, It last)
+    {
+        insert(first, last);
+    }
+    jflat_map(const jflat_map&) = default;
+    jflat_map(jflat_map&&) noexcept = default;
+    jflat_map& operator=(jflat_map&&) noexcept = default;
+    //members can not be assigned, their keys are const
+    jflat_map& operator=(const jflat_map& r)
+    {
+        if (this != &r)
+        {
+            *this = jflat_map(r);
+        }
+        return *this;
+    }
+
+    iterator begin() { return _v.begin(); }
+    iterator end() { return _v.end(); }
+    const_iterator begin() const { return _v.begin(); }
+    const_iterator end() const { return _v.end(); }
+    const_iterator cbegin() const { return _v.cbegin(); }
+    const_iterator cend() const { return _v.cend(); }
+
+    size_type size() const { return _v.size(); }
+    bool empty() const { return _v.empty(); }
+    size_type capacity() const { return _v.capacity(); }
+    void clear()
+    {
+        _v.clear();
+        _slots.clear();
+    }
+    void reserve(size_type n)
+    {
+        _v.reserve(n);
+    }
+
+    //`key` is a `jkey` or anything a `std::string_view` can be made of
+    template<class K>
+    iterator find(const K& key)
+    {
+        return _v.begin() + index_of(key);
+    }
+    template<class K>
+    const_iterator find(const K& key) const
+    {
+        return _v.begin() + index_of(key);
+    }
+    template<class K>
+    size_type count(const K& key) const
+    {
+        return index_of(key) != _v.size() ? 1 : 0;
+    }
+
+    template<class K>
+    T& at(const K& key)
+    {
+        auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("jflat_map::at");
+        }
+        return it->second;
+    }
+    template<class K>
+    const T& at(const K& key) const
+    {
+        return const_cast<jflat_map*>(this)->at(key);
+    }
+    T& operator[](const std::string& key)
+    {
+        return try_emplace(key).first->second;
+    }
+    T& operator[](std::string&& key)
+    {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    template<class K, class... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+    {
+        size_t i = index_of(key);
+        if (i != _v.size())
+        {
+            return{ _v.begin() + i, false };
+        }
+        _v.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+        if (!_slots.empty() && _v.size() * 2 <= _slots.size())
+        {
+            add_slot(i);
+        }
+        else if (_v.size() > linear_limit)
+        {
+            rehash();
+        }
+        return{ _v.begin() + i, true };
+    }
+    template<class K, class V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value)
+    {
+        return try_emplace(std::forward<K>(key), std::forward<V>(value));
+    }
+    std::pair<iterator, bool> insert(const value_type& v)
+    {
+        return try_emplace(v.first, v.second);
+    }
+    std::pair<iterator, bool> insert(value_type&& v)
+    {
+        return try_emplace(v.first, std::move(v.second));
+    }
+    template<class It>
+    void insert(It first, It last)
+    {
+        for (; first != last; ++first)
+        {
+            insert(*first);
+        }
+    }
+
+    //the members after it move down in place, the indexes are rebuilt
+    iterator erase(const_iterator pos)
+    {
+        static_assert(std::is_nothrow_move_constructible<value_type>::value, "a member must not be lost halfway");
+        size_t i = pos - _v.cbegin();
+        for (size_t j = i; j + 1 < _v.size(); j++)
+        {
+            //members can not be assigned as their keys are const, they are rebuilt over the previous one
+            _v[j].~value_type();
+            new (&_v[j]) value_type(std::move(_v[j + 1]));
+        }
+        _v.pop_back();
+        rehash();
+        return _v.begin() + i;
+    }
+    template<class K>
+    size_type erase(const K& key)
+    {
+        size_t i = index_of(key);
+        if (i == _v.size())
+        {
+            return 0;
+        }
+        erase(_v.cbegin() + i);
+        return 1;
+    }
+
+    //moves the members whose key is not in this map yet, like `std::map::merge`
+    void merge(jflat_map& source)
+    {
+        std::vector<value_type> left;
+        for (auto& member : source._v)
+        {
+            if (count(member.first) != 0)
+            {
+                left.push_back(std::move(member));
+            }
+            else
+            {
+                try_emplace(member.first, std::move(member.second));
+            }
+        }
+        source._v.swap(left);
+        source.rehash();
+    }
+
+    friend bool operator==(const jflat_map& l, const jflat_map& r)
+    {
+        if (l.size() != r.size())
+        {
+            return false;
+        }
+        for (auto& member : l._v)
+        {
+            auto it = r.find(member.first);
+            if (it == r.end() || !(it->second == member.second))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    friend bool operator!=(const jflat_map& l, const jflat_map& r)
+    {
+        return !(l == r);
+    }
+private:
+    static const size_t linear_limit = 8; //smaller maps are searched member by member
+
+    //the index of the member with `key`, `size()` when there is none
+    template<class K>
+    size_t index_of(const K& key) const
+    {
+        if constexpr (std::is_same<K, jkey>::value)
+        {
+            return index_of(key.str(), key.hash(), &key);
+        }
+        else
+        {
+            std::string_view k(key);
+            return index_of(k, _slots.empty() ? 0 : std::hash<std::string_view>()(k), nullptr);
+        }
+    }
+
+    //`same` is the key itself when it is a `jkey`, a shared one matches by pointer
+    size_t index_of(std::string_view key, size_t h, const jkey* same) const
+    {
+        auto equal = [&](const jkey& k) { return same != nullptr ? k == *same : k == key; };
+        if (_slots.empty())
+        {
+            for (size_t i = 0; i < _v.size(); i++)
+            {
+                if (equal(_v[i].first))
+                {
+                    return i;
+                }
+            }
+            return _v.size();
+        }
+        size_t mask = _slots.size() - 1;
+        for (size_t s = h & mask; _slots[s] != 0; s = (s + 1) & mask)
+        {
+            const jkey& k = _v[_slots[s] - 1].first;
+            if (k.hash() == h && equal(k))
+            {
+                return _slots[s] - 1;
+            }
+        }
+        return _v.size();
+    }
+
+    void add_slot(size_t i)
+    {
+        size_t mask = _slots.size() - 1;
+        size_t s = _v[i].first.hash() & mask;
+        while (_slots[s] != 0)
+        {
+            s = (s + 1) & mask;
+        }
+        _slots[s] = static_cast<uint32_t>(i + 1);
+    }
+
+    //at most half of the slots are used, probes stay short
+    void rehash()
+    {
+        _slots.clear();
+        if (_v.size() <= linear_limit)
+        {
+            return;
+        }
+        size_t n = 16;
+        while (n < _v.size() * 4)
+        {
+            n *= 2;
+        }
+        _slots.assign(n, 0);
+        for (size_t i = 0; i < _v.size(); i++)
+        {
+            add_slot(i);
+        }
+    }
+
+    std::vector<value_type> _v;
+    std::vector<uint32_t> _slots; //index + 1 of a member, 0 when free; empty while searched linearly
+};
+
+}
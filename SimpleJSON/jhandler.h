@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <string_view>
+namespace mq
+{
+
+/*
+ * Receives the values of a document one by one from
+ * `jparser::parse(std::string_view, jhandler&, std::string&)`, no `json`
+ * is built. A string passed to `on_key` or `on_string` is only valid
+ * during the call. Returning false from any callback stops the parsing.
+ */
+class jhandler
+{
+public:
+    virtual ~jhandler() = default;
+
+    virtual bool on_start_object() { return true; }
+    virtual bool on_end_object() { return true; }
+    virtual bool on_start_array() { return true; }
+    virtual bool on_end_array() { return true; }
+    virtual bool on_key(std::string_view /*key*/) { return true; }
+    virtual bool on_string(std::string_view /*s*/) { return true; }
+    virtual bool on_int64(int64_t /*i*/) { return true; }
+    virtual bool on_double(double /*d*/) { return true; }
+    virtual bool on_bool(bool /*b*/) { return true; }
+    virtual bool on_null() { return true; }
+};
+
+}
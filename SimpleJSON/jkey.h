@@ -0,0 +1,192 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace mq
+{
+
+/*
+ * An immutable, reference counted object key that remembers its hash.
+ * Copies share one string, so keys handed out by a `jkey_table` for the
+ * same text are equal by pointer and cost no allocation per object.
+ */
+class jkey
+{
+public:
+    jkey() : _node(nullptr) {}
+    jkey(const char* s) : jkey(std::string(s)) {}
+    jkey(std::string_view s) : jkey(std::string(s)) {}
+    jkey(const std::string& s) : jkey(std::string(s)) {}
+    jkey(std::string&& s) : _node(new node{ { 1 }, std::hash<std::string_view>()(s), std::move(s) }) {}
+
+    jkey(const jkey& r) noexcept : _node(r._node)
+    {
+        if (_node != nullptr)
+        {
+            _node->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    jkey(jkey&& r) noexcept : _node(r._node)
+    {
+        r._node = nullptr;
+    }
+    jkey& operator=(jkey r) noexcept
+    {
+        std::swap(_node, r._node);
+        return *this;
+    }
+    ~jkey()
+    {
+        if (_node != nullptr && _node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete _node;
+        }
+    }
+
+    const std::string& str() const
+    {
+        static const std::string empty;
+        return _node != nullptr ? _node->s : empty;
+    }
+    operator const std::string&() const
+    {
+        return str();
+    }
+    size_t size() const
+    {
+        return str().size();
+    }
+    //the one of `std::hash<std::string_view>`
+    size_t hash() const
+    {
+        return _node != nullptr ? _node->hash : std::hash<std::string_view>()(std::string_view());
+    }
+
+    friend bool operator==(const jkey& l, const jkey& r)
+    {
+        return l._node == r._node || (l.hash() == r.hash() && l.str() == r.str());
+    }
+    friend bool operator!=(const jkey& l, const jkey& r)
+    {
+        return !(l == r);
+    }
+    friend bool operator==(const jkey& l, std::string_view r)
+    {
+        return l.str() == r;
+    }
+    friend bool operator!=(const jkey& l, std::string_view r)
+    {
+        return l.str() != r;
+    }
+    friend bool operator==(const jkey& l, const char* r)
+    {
+        return l.str() == r;
+    }
+    friend bool operator!=(const jkey& l, const char* r)
+    {
+        return l.str() != r;
+    }
+    friend bool operator<(const jkey& l, const jkey& r)
+    {
+        return l.str() < r.str();
+    }
+private:
+    friend class jkey_table;
+    bool is_set() const
+    {
+        return _node != nullptr;
+    }
+
+    struct node
+    {
+        std::atomic<uint32_t> refs;
+        size_t hash;
+        std::string s;
+    };
+    node* _node;
+};
+
+/*
+ * Hands out one shared `jkey` per distinct text. A parser keeps one for
+ * the document it parses, one can also be given to several parses so
+ * that their documents share keys. Not safe to use from several threads
+ * at once, the keys it returns are. A table shared for long should be
+ * given a `max_size`, or be cleared from time to time; the keys already
+ * handed out stay valid either way.
+ */
+class jkey_table
+{
+public:
+    //`max_size` distinct keys at most, 0 for no limit; past it new keys are not shared
+    explicit jkey_table(size_t max_size = 0) : _size(0), _max_size(max_size) {}
+
+    jkey intern(std::string_view s)
+    {
+        size_t h = std::hash<std::string_view>()(s);
+        if (_size * 2 >= _slots.size())
+        {
+            grow();
+        }
+        size_t mask = _slots.size() - 1;
+        size_t i = h & mask;
+        for (; _slots[i].is_set(); i = (i + 1) & mask)
+        {
+            if (_slots[i].hash() == h && _slots[i] == s)
+            {
+                return _slots[i];
+            }
+        }
+        if (_max_size != 0 && _size >= _max_size)
+        {
+            return jkey(s);
+        }
+        ++_size;
+        _slots[i] = jkey(s);
+        return _slots[i];
+    }
+    size_t size() const
+    {
+        return _size;
+    }
+    size_t max_size() const
+    {
+        return _max_size;
+    }
+    void clear()
+    {
+        _slots.clear();
+        _size = 0;
+    }
+private:
+    void grow()
+    {
+        std::vector<jkey> old(std::max<size_t>(16, _slots.size() * 2));
+        old.swap(_slots);
+        size_t mask = _slots.size() - 1;
+        for (auto& key : old)
+        {
+            if (key.is_set())
+            {
+                size_t i = key.hash() & mask;
+                while (_slots[i].is_set())
+                {
+                    i = (i + 1) & mask;
+                }
+                _slots[i] = std::move(key);
+            }
+        }
+    }
+
+    std::vector<jkey> _slots;
+    size_t _size;
+    size_t _max_size;
+};
+
+}
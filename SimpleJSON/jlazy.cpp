@@ -0,0 +1,262 @@
+#include "jlazy.h"
+#include "jparser.h"
+#include "jscanner.h"
+#include <stdexcept>
+namespace mq
+{
+
+jlazy::document::document()
+{
+    _tokens.push_back(0); //an empty text, read as null like `jparser::parse` does
+}
+
+jlazy jlazy::document::root() const
+{
+    jlazy v;
+    v._s = _text.data();
+    v._len = _text.size();
+    v._tokens = _tokens.data();
+    v._token = 0;
+    return v;
+}
+
+jlazy jlazy::document::operator[](std::string_view key) const
+{
+    return root()[key];
+}
+
+jlazy jlazy::document::operator[](size_t i) const
+{
+    return root()[i];
+}
+
+jlazy::document jlazy::document::parse(std::string_view s)
+{
+    if (s.size() >= UINT32_MAX)
+    {
+        throw std::runtime_error(("Text too long to be indexed"));
+    }
+    document doc;
+    doc._text = s;
+    doc._tokens.clear();
+    jscanner::index(s.data(), s.size(), doc._tokens);
+    return doc;
+}
+
+jlazy::jlazy()
+    : _s(nullptr)
+    , _len(0)
+    , _tokens(nullptr)
+    , _token(0)
+{
+}
+
+jlazy::jlazy(const jlazy& from, size_t token)
+    : _s(from._s)
+    , _len(from._len)
+    , _tokens(from._tokens)
+    , _token(token)
+{
+}
+
+/*
+ * The type is told by the first byte, anything that is not the start of
+ * a value is null, as in `jparser::parse_value`.
+ */
+json::type jlazy::value_type() const
+{
+    if (_tokens == nullptr || _tokens[_token] >= _len)
+    {
+        return json::NUL;
+    }
+    char c = _s[_tokens[_token]];
+    switch (c)
+    {
+    case '{':
+        return json::OBJECT;
+    case '[':
+        return json::ARRAY;
+    case '\"':
+        return json::STRING;
+    case 't': case 'f':
+        return json::BOOLEAN;
+    default:
+        return c == '-' || (c >= '0' && c <= '9') ? json::NUMBER : json::NUL;
+    }
+}
+
+bool jlazy::is_null() const
+{
+    return value_type() == json::NUL;
+}
+
+bool jlazy::as_bool() const
+{
+    return value_type() == json::BOOLEAN ? value().as_bool() : false;
+}
+
+int64_t jlazy::as_int() const
+{
+    return value_type() == json::NUMBER ? value().as_int() : 0;
+}
+
+double jlazy::as_double() const
+{
+    return value_type() == json::NUMBER ? value().as_double() : 0;
+}
+
+std::string jlazy::as_string() const
+{
+    return value_type() == json::STRING ? value().as_string() : std::string();
+}
+
+json jlazy::value() const
+{
+    if (value_type() == json::NUL)
+    {
+        return json::null;
+    }
+    size_t begin = _tokens[_token];
+    size_t end = _tokens[skip(_token)];
+    std::string err;
+    json v = jparser::parse(std::string_view(_s + begin, end - begin), err);
+    if (!err.empty())
+    {
+        throw std::runtime_error(err + " in the value at position " + std::to_string(begin));
+    }
+    return v;
+}
+
+jlazy jlazy::operator[](std::string_view key) const
+{
+    if (value_type() != json::OBJECT)
+    {
+        return jlazy();
+    }
+    size_t t = _token + 1;
+    if (at(t) == '}')
+    {
+        return jlazy();
+    }
+    for (;;)
+    {
+        if (at(t) != '\"')
+        {
+            throw std::runtime_error(("Expected string at position ") + std::to_string(_tokens[t]));
+        }
+        if (at(t + 1) != ':')
+        {
+            throw std::runtime_error(("Expected `:` at position ") + std::to_string(_tokens[t + 1]));
+        }
+        bool found = key_equals(t, key);
+        t += 2;
+        if (found)
+        {
+            return jlazy(*this, t);
+        }
+        t = skip(t);
+        char c = at(t);
+        if (c == '}')
+        {
+            return jlazy();
+        }
+        if (c != ',')
+        {
+            throw std::runtime_error(("Expected `}` or `,` at position ") + std::to_string(_tokens[t]));
+        }
+        ++t;
+    }
+}
+
+jlazy jlazy::operator[](size_t i) const
+{
+    if (value_type() != json::ARRAY)
+    {
+        return jlazy();
+    }
+    size_t t = _token + 1;
+    if (at(t) == ']')
+    {
+        return jlazy();
+    }
+    for (;; --i)
+    {
+        if (i == 0)
+        {
+            return jlazy(*this, t);
+        }
+        t = skip(t);
+        char c = at(t);
+        if (c == ']')
+        {
+            return jlazy();
+        }
+        if (c != ',')
+        {
+            throw std::runtime_error(("Expected `,` or `]` at position ") + std::to_string(_tokens[t]));
+        }
+        ++t;
+    }
+}
+
+//the first byte of token `t`, the end of the text is never stepped over
+char jlazy::at(size_t t) const
+{
+    if (_tokens[t] >= _len)
+    {
+        throw std::runtime_error(("Unexpected end of input"));
+    }
+    return _s[_tokens[t]];
+}
+
+/*
+ * Returns the index of the token after the value starting at token `t`.
+ * A string, number or literal is a single token, a container ends at the
+ * bracket that brings the depth back to zero. What is skipped is not
+ * checked any further.
+ */
+size_t jlazy::skip(size_t t) const
+{
+    size_t depth = 0;
+    do
+    {
+        switch (at(t))
+        {
+        case '{': case '[':
+            ++depth;
+            break;
+        case '}': case ']':
+            if (depth == 0) //no value at all
+            {
+                throw std::runtime_error(("Unexpected character at position ") + std::to_string(_tokens[t]));
+            }
+            --depth;
+            break;
+        default:;
+        }
+        ++t;
+    } while (depth != 0);
+    return t;
+}
+
+/*
+ * Token `t` opens a key and token `t + 1` is the `:` after it. Only a key
+ * with escapes in it is decoded before comparing.
+ */
+bool jlazy::key_equals(size_t t, std::string_view key) const
+{
+    const char* begin = _s + _tokens[t] + 1;
+    const char* end = _s + _tokens[t + 1];
+    while (end[-1] != '\"') //spaces before the `:`
+    {
+        --end;
+    }
+    std::string_view raw(begin, end - 1 - begin);
+    if (raw.find('\\') == std::string_view::npos)
+    {
+        return raw == key;
+    }
+    return jparser::parse(std::string_view(begin - 1, end - begin + 1)).as_string() == key;
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "json.h"
+#include <string_view>
+#include <vector>
+namespace mq
+{
+
+/*
+ * A value of a `jlazy::document`. Nothing is parsed until it is asked
+ * for: `operator[]` steps over the members before the wanted one by
+ * bracket matching, and only `value()` and `as_*` build values, for the
+ * subtree they are called on. Missing members and elements, like in
+ * `json`, give a null value. Malformed parts are found only when they are
+ * reached, and then a `std::runtime_error` is thrown.
+ */
+class jlazy
+{
+public:
+    class document;
+
+    jlazy();
+
+    json::type value_type() const;
+    bool is_null() const;
+
+    bool as_bool() const;
+    int64_t as_int() const;
+    double as_double() const;
+    std::string as_string() const;
+    json value() const;
+
+    jlazy operator[](std::string_view key) const;
+    jlazy operator[](size_t i) const;
+private:
+    jlazy(const jlazy& from, size_t token);
+    char at(size_t t) const;
+    size_t skip(size_t t) const;
+    bool key_equals(size_t t, std::string_view key) const;
+
+    const char* _s;
+    size_t _len;
+    const uint32_t* _tokens; //null for a missing value
+    size_t _token; //index of the first token of the value
+};
+
+/*
+ * Only the structural index of `jscanner` is built up front. The text is
+ * not copied, it must outlive the document and every value taken from it.
+ */
+class jlazy::document
+{
+public:
+    document();
+
+    jlazy root() const;
+    jlazy operator[](std::string_view key) const;
+    jlazy operator[](size_t i) const;
+
+    static document parse(std::string_view s);
+private:
+    std::string_view _text;
+    std::vector<uint32_t> _tokens;
+};
+
+}
@@ -0,0 +1,160 @@
+#include "jmapping.h"
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+namespace mq
+{
+
+jmapping::jmapping()
+    : _data(nullptr)
+    , _size(0)
+#ifdef _WIN32
+    , _file(INVALID_HANDLE_VALUE)
+    , _mapping(nullptr)
+#endif
+{
+}
+
+jmapping::~jmapping()
+{
+    close();
+}
+
+jmapping::jmapping(jmapping&& r) noexcept
+    : jmapping()
+{
+    *this = std::move(r);
+}
+
+jmapping& jmapping::operator=(jmapping&& r) noexcept
+{
+    if (this != &r)
+    {
+        close();
+        std::swap(_data, r._data);
+        std::swap(_size, r._size);
+#ifdef _WIN32
+        std::swap(_file, r._file);
+        std::swap(_mapping, r._mapping);
+#endif
+    }
+    return *this;
+}
+
+std::string_view jmapping::view() const
+{
+    return std::string_view(_data, _size);
+}
+
+#ifdef _WIN32
+bool jmapping::open(const std::string& path, std::string& err)
+{
+    close();
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        err = "Cannot open file " + path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size))
+    {
+        err = "Cannot get the size of file " + path;
+        close();
+        return false;
+    }
+    if (size.QuadPart == 0) //an empty file can not be mapped
+    {
+        return true;
+    }
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping != nullptr)
+    {
+        _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (_data == nullptr)
+    {
+        err = "Cannot map file " + path;
+        close();
+        return false;
+    }
+    _size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void jmapping::close()
+{
+    if (_data != nullptr)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_file);
+    }
+    _data = nullptr;
+    _size = 0;
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+}
+#else
+bool jmapping::open(const std::string& path, std::string& err)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        err = "Cannot open file " + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        err = "Cannot get the size of file " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) //an empty file can not be mapped
+    {
+        ::close(fd);
+        return true;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); //the mapping keeps the file alive
+    if (data == MAP_FAILED)
+    {
+        err = "Cannot map file " + path + ": " + strerror(errno);
+        return false;
+    }
+    madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(data);
+    _size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void jmapping::close()
+{
+    if (_data != nullptr)
+    {
+        munmap(const_cast<char*>(_data), _size);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+#endif
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+namespace mq
+{
+
+/*
+ * A read-only memory mapping of a whole file.
+ */
+class jmapping
+{
+public:
+    jmapping();
+    ~jmapping();
+    jmapping(const jmapping&) = delete;
+    jmapping& operator=(const jmapping&) = delete;
+    jmapping(jmapping&& r) noexcept;
+    jmapping& operator=(jmapping&& r) noexcept;
+
+    bool open(const std::string& path, std::string& err);
+    void close();
+    std::string_view view() const;
+private:
+    const char* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _file;
+    void* _mapping;
+#endif
+};
+
+}
@@ -0,0 +1,115 @@
+#include "jnode_arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+namespace mq
+{
+
+namespace
+{
+const size_t max_block_size = 1 << 20;
+}
+
+jnode_arena::jnode_arena(size_t block_size)
+    : blocks(nullptr)
+    , cleanups(nullptr)
+    , cur(nullptr)
+    , end(nullptr)
+    , block_size(block_size)
+    , used_bytes(0)
+{
+}
+
+jnode_arena::~jnode_arena()
+{
+    clear();
+    std::free(blocks);
+}
+
+void* jnode_arena::allocate(size_t size, size_t align)
+{
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    if (p + size > reinterpret_cast<uintptr_t>(end))
+    {
+        new_block(size + align);
+        p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    }
+    cur = reinterpret_cast<char*>(p + size);
+    used_bytes += size;
+    return reinterpret_cast<void*>(p);
+}
+
+/*
+ * Run all destructors and give back every block but the newest one,
+ * which is normally the biggest, so a reused arena settles on one block.
+ */
+void jnode_arena::clear()
+{
+    run_cleanups();
+    if (blocks == nullptr)
+    {
+        return;
+    }
+    block* b = blocks->next;
+    while (b != nullptr)
+    {
+        block* next = b->next;
+        std::free(b);
+        b = next;
+    }
+    blocks->next = nullptr;
+    cur = reinterpret_cast<char*>(blocks + 1);
+    end = reinterpret_cast<char*>(blocks) + blocks->size;
+    used_bytes = 0;
+}
+
+size_t jnode_arena::used() const
+{
+    return used_bytes;
+}
+
+size_t jnode_arena::capacity() const
+{
+    size_t size = 0;
+    for (block* b = blocks; b != nullptr; b = b->next)
+    {
+        size += b->size;
+    }
+    return size;
+}
+
+void jnode_arena::add_cleanup(void* obj, void (*destroy)(void*))
+{
+    cleanups = new (allocate(sizeof(cleanup), alignof(cleanup))) cleanup{obj, destroy, cleanups};
+}
+
+void jnode_arena::new_block(size_t min_size)
+{
+    size_t size = std::max(block_size, min_size + sizeof(block));
+    block* b = static_cast<block*>(std::malloc(size));
+    if (b == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    b->next = blocks;
+    b->size = size;
+    blocks = b;
+    cur = reinterpret_cast<char*>(b + 1);
+    end = reinterpret_cast<char*>(b) + size;
+    if (block_size < max_block_size)
+    {
+        block_size *= 2;
+    }
+}
+
+void jnode_arena::run_cleanups()
+{
+    while (cleanups != nullptr) //newest first, the reverse order of construction
+    {
+        cleanup* c = cleanups;
+        cleanups = c->next;
+        c->destroy(c->obj);
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#pragma push_macro("new")
+#undef new //placement new does not work with the DEBUG_NEW macro in json.h
+
+namespace mq
+{
+
+/*
+ * A bump allocator for the value nodes of a `json::document`. Memory is
+ * carved out of large blocks and only given back all at once when the
+ * arena is cleared or destroyed. Objects that own resources register
+ * their destructor, which is run at that time.
+ * Only the nodes themselves live here: the buffers of their strings,
+ * vectors and maps still come from the heap, so clearing costs one
+ * destructor call and the matching frees per node, not per block.
+ */
+class jnode_arena
+{
+public:
+    explicit jnode_arena(size_t block_size = 4096);
+    ~jnode_arena();
+
+    jnode_arena(const jnode_arena&) = delete;
+    jnode_arena& operator=(const jnode_arena&) = delete;
+
+    void* allocate(size_t size, size_t align);
+
+    //construct an object whose destructor is never run
+    template<class T, class... Args>
+    T* construct(Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<class T, class... Args>
+    T* create(Args&&... args)
+    {
+        T* obj = construct<T>(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            add_cleanup(obj, [](void* p) { static_cast<T*>(p)->~T(); });
+        }
+        return obj;
+    }
+
+    void clear();
+    size_t used() const;
+    size_t capacity() const;
+private:
+    struct block
+    {
+        block* next;
+        size_t size;
+    };
+    struct cleanup
+    {
+        void* obj;
+        void (*destroy)(void*);
+        cleanup* next;
+    };
+
+    void add_cleanup(void* obj, void (*destroy)(void*));
+    void new_block(size_t min_size);
+    void run_cleanups();
+
+    block* blocks;
+    cleanup* cleanups;
+    char* cur;
+    char* end;
+    size_t block_size;
+    size_t used_bytes;
+};
+
+}
+
+#pragma pop_macro("new")
@@ -1,37 +1,642 @@
 #include "jparser.h"
-#include <cerrno>
+#include "jvalue.h"
+#include "jscanner.h"
+#include "jmapping.h"
+#include "jutf8.h"
+#include <algorithm>
 #include <cctype>
 #include <cassert>
+#include <charconv>
 #include <cstdlib>
+#include <condition_variable>
 #include <cstring>
-#include <clocale>
-#include <cuchar>
+#include <iterator>
+#include <mutex>
+#include <thread>
 namespace mq
 {
-json jparser::parse(const std::string& s, std::string& err) noexcept
+jparser::result jparser::try_parse(std::string_view s) noexcept
 {
-    try
+    jparser parser(s, nullptr);
+    result r{ parser.parse_value(), parser.failure };
+    if (r.err)
+    {
+        r.value = json();
+    }
+    return r;
+}
+
+json jparser::parse(std::string_view s, std::string& err) noexcept
+{
+    jparser parser(s, nullptr);
+    json v = parser.parse_value();
+    if (parser.failed(err))
     {
-        jparser parser(s);
-        return parser.parse_value();
+        return json::null;
     }
-    catch (std::runtime_error& errorMsg)
+    return v;
+}
+
+json jparser::parse(std::string_view s, numbers mode, std::string& err) noexcept
+{
+    jparser parser(s, nullptr);
+    parser.number_mode = mode;
+    json v = parser.parse_value();
+    if (parser.failed(err))
     {
-        err = errorMsg.what();
         return json::null;
     }
+    return v;
 }
 
-json jparser::parse(const std::string& s) noexcept
+#ifdef MQ_JSON_FLAT_OBJECT
+json jparser::parse(std::string_view s, jkey_table& keys, std::string& err) noexcept
+{
+    jparser parser(s, nullptr);
+    parser.key_table = &keys;
+    json v = parser.parse_value();
+    if (parser.failed(err))
+    {
+        return json::null;
+    }
+    return v;
+}
+#endif
+
+json jparser::parse(std::string_view s) noexcept
 {
     std::string err;
     return parse(s, err);
 }
 
-jparser::jparser(const std::string& s)
-    : s(s.c_str())
-    , p(s.c_str())
+json jparser::parse(const char* s, size_t len, std::string& err) noexcept
+{
+    return parse(std::string_view(s, len), err);
+}
+
+json jparser::parse(const char* s, size_t len) noexcept
+{
+    return parse(std::string_view(s, len));
+}
+
+bool jparser::parse(std::string_view s, json::document& doc, std::string& err) noexcept
+{
+    doc.clear();
+    jparser parser(s, doc._arena.get());
+    doc._root = parser.parse_value();
+    if (parser.failed(err))
+    {
+        doc.clear();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Keys interned by a reused parser are kept for the next documents, as
+ * they mostly have the same ones, unless there are too many of them.
+ */
+jparser::result jparser::try_read(std::string_view s) noexcept
+{
+#ifdef MQ_JSON_FLAT_OBJECT
+    if (own_keys.size() > max_kept_keys)
+    {
+        own_keys.clear();
+    }
+#endif
+    arena = nullptr;
+    start(s, 0, s.size());
+    result r{ parse_value(), failure };
+    if (r.err)
+    {
+        r.value = json();
+    }
+    return r;
+}
+
+json jparser::read(std::string_view s, std::string& err) noexcept
+{
+    result r = try_read(s);
+    if (r.err)
+    {
+        err = r.err.what();
+    }
+    return std::move(r.value);
+}
+
+bool jparser::read(std::string_view s, json::document& doc, std::string& err) noexcept
+{
+    doc.clear();
+#ifdef MQ_JSON_FLAT_OBJECT
+    if (own_keys.size() > max_kept_keys)
+    {
+        own_keys.clear();
+    }
+#endif
+    arena = doc._arena.get();
+    start(s, 0, s.size());
+    doc._root = parse_value();
+    arena = nullptr;
+    if (failed(err))
+    {
+        doc.clear();
+        return false;
+    }
+    return true;
+}
+
+#ifdef MQ_JSON_FLAT_OBJECT
+void jparser::intern_keys(bool on)
 {
+    own_keys.clear();
+    key_table = on ? &own_keys : nullptr;
+}
+#endif
+
+/*
+ * No value is built, `handler` is told about each one in document order.
+ * Returns false on a syntax error, or with `err` untouched when a callback
+ * stopped the parsing.
+ */
+bool jparser::parse(std::string_view s, jhandler& handler, std::string& err) noexcept
+{
+    jparser parser(s, nullptr);
+    bool go_on = parser.parse_events(handler);
+    return !parser.failed(err) && go_on;
+}
+
+jparser::error jparser::validate(std::string_view s) noexcept
+{
+    jparser parser;
+    parser.start(s, 0, s.size());
+    parser.validate_text();
+    return parser.failure;
+}
+
+/*
+ * A top level array or object is cut at some of its commas into one range
+ * per thread, each range is parsed on its own thread and the results are
+ * joined in order. Anything else, or a text too small to be worth it, is
+ * parsed by `parse`. `threads` is the number of hardware threads when 0.
+ */
+json jparser::parse_parallel(std::string_view s, std::string& err, unsigned threads) noexcept
+{
+    const size_t min_range = 1 << 16;
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    size_t parts = std::min<size_t>(threads, s.size() / min_range);
+    size_t start = s.find_first_not_of(" \t\n\r");
+    if (parts < 2 || start == std::string_view::npos || (s[start] != '[' && s[start] != '{') || s.size() >= UINT32_MAX)
+    {
+        return parse(s, err);
+    }
+    std::vector<size_t> bounds{ start };
+    size_t close;
+    if (!jscanner::split(s.data() + start, s.size() - start, parts, bounds, close))
+    {
+        return parse(s, err); //for the error message
+    }
+    for (size_t i = 1; i < bounds.size(); i++)
+    {
+        bounds[i] += start;
+    }
+    bounds.push_back(start + close);
+
+    bool is_object = s[start] == '{';
+    parts = bounds.size() - 1;
+    std::vector<json::object> objects(is_object ? parts : 0);
+    std::vector<json::array> arrays(is_object ? 0 : parts);
+    std::vector<std::string> errors(parts);
+    auto parse_range = [&](size_t i)
+    {
+        try
+        {
+            jparser parser(s, bounds[i] + 1, bounds[i + 1]); //after the bracket or the comma
+            if (is_object)
+            {
+                parser.parse_members(objects[i], parts == 1);
+            }
+            else
+            {
+                parser.parse_elements(arrays[i], parts == 1);
+            }
+            parser.failed(errors[i]);
+        }
+        catch (std::bad_alloc&) //must not escape the thread
+        {
+            errors[i] = "Out of memory";
+        }
+    };
+    std::vector<std::thread> workers;
+    size_t started = 1;
+    try
+    {
+        workers.reserve(parts - 1);
+        for (; started < parts; started++)
+        {
+            workers.emplace_back(parse_range, started);
+        }
+    }
+    catch (std::exception&) //no more threads, the ranges left are parsed here
+    {
+    }
+    parse_range(0);
+    for (size_t i = started; i < parts; i++)
+    {
+        parse_range(i);
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    for (auto& error : errors)
+    {
+        if (!error.empty())
+        {
+            err = error;
+            return json::null;
+        }
+    }
+
+    if (is_object)
+    {
+        json::object obj = std::move(objects[0]);
+        for (size_t i = 1; i < parts; i++)
+        {
+            obj.merge(objects[i]);
+            if (!objects[i].empty()) //a duplicated key, left behind by `merge`
+            {
+                return parse(s, err); //for the first one and its position
+            }
+        }
+        return obj;
+    }
+    size_t size = 0;
+    for (auto& arr : arrays)
+    {
+        size += arr.size();
+    }
+    json::array arr = std::move(arrays[0]);
+    arr.reserve(size);
+    for (size_t i = 1; i < parts; i++)
+    {
+        std::move(arrays[i].begin(), arrays[i].end(), std::back_inserter(arr));
+        json::array().swap(arrays[i]);
+    }
+    return arr;
+}
+
+struct jparser::ndjson_record
+{
+    size_t line; //counted from the first line of its batch
+    json value;
+    std::string err;
+};
+
+/*
+ * The text is cut after a newline about every 64 KiB into batches, which
+ * worker threads take in order and parse line by line. Raw newlines can
+ * not appear inside a JSON string, so `memchr` alone finds the line ends.
+ * The callback is called on this thread, in order, as batches complete.
+ * Workers run at most a few batches ahead of it, so memory stays bounded
+ * however big the text is.
+ */
+bool jparser::parse_ndjson(std::string_view s, const ndjson_callback& callback, unsigned threads)
+{
+    const size_t batch_size = 1 << 16;
+    struct batch
+    {
+        size_t begin;
+        size_t end;
+        size_t lines;
+        std::vector<ndjson_record> records;
+        bool ready;
+        bool out_of_memory; //reported as an error on its first line
+    };
+    std::vector<batch> batches;
+    for (size_t begin = 0; begin < s.size();)
+    {
+        size_t end = s.size();
+        if (s.size() - begin > batch_size)
+        {
+            auto nl = static_cast<const char*>(memchr(s.data() + begin + batch_size, '\n', s.size() - begin - batch_size));
+            end = nl == nullptr ? s.size() : nl - s.data() + 1;
+        }
+        batches.push_back({ begin, end, 0, {}, false, false });
+        begin = end;
+    }
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, batches.size()));
+
+    std::mutex lock;
+    std::condition_variable changed;
+    size_t next = 0; //the batch to be taken by a worker
+    size_t consumed = 0; //batches given to the callback
+    bool stop = false;
+    const size_t window = 2 * static_cast<size_t>(threads);
+    auto parse_batch = [&](batch& b)
+    {
+        try
+        {
+            b.lines = parse_lines(s, b.begin, b.end, b.records);
+        }
+        catch (std::bad_alloc&) //must not escape a worker thread
+        {
+            std::vector<ndjson_record>().swap(b.records);
+            b.lines = std::count(s.begin() + b.begin, s.begin() + b.end, '\n') + (s[b.end - 1] != '\n' ? 1 : 0);
+            b.out_of_memory = true;
+        }
+    };
+    auto work = [&]
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;)
+        {
+            changed.wait(guard, [&] { return stop || next == batches.size() || next < consumed + window; });
+            if (stop || next == batches.size())
+            {
+                return;
+            }
+            batch& b = batches[next++];
+            guard.unlock();
+            parse_batch(b);
+            guard.lock();
+            b.ready = true;
+            changed.notify_all();
+        }
+    };
+    std::vector<std::thread> workers;
+    try
+    {
+        if (threads > 1)
+        {
+            workers.reserve(threads);
+            for (unsigned i = 0; i < threads; i++)
+            {
+                workers.emplace_back(work);
+            }
+        }
+    }
+    catch (std::exception&) //no more threads, the ones started do the work, or this one when there are none
+    {
+    }
+    auto finish = [&]
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        changed.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    };
+
+    size_t first_line = 1;
+    try
+    {
+        for (auto& b : batches)
+        {
+            if (workers.empty())
+            {
+                parse_batch(b);
+            }
+            else
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&b] { return b.ready; });
+            }
+            if (b.out_of_memory && !callback(first_line, json(), "Out of memory"))
+            {
+                finish();
+                return false;
+            }
+            for (auto& record : b.records)
+            {
+                if (!callback(first_line + record.line, std::move(record.value), record.err))
+                {
+                    finish();
+                    return false;
+                }
+            }
+            first_line += b.lines;
+            std::vector<ndjson_record>().swap(b.records);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                ++consumed;
+            }
+            changed.notify_all();
+        }
+    }
+    catch (...) //thrown by the callback, workers must not outlive the text
+    {
+        finish();
+        throw;
+    }
+    finish();
+    return true;
+}
+
+/*
+ * One value per line that is not blank, a line that fails is null.
+ */
+std::vector<json> jparser::parse_ndjson(std::string_view s, std::vector<line_error>& errors, unsigned threads)
+{
+    std::vector<json> values;
+    parse_ndjson(s, [&](size_t line, json&& value, const std::string& err)
+    {
+        if (!err.empty())
+        {
+            errors.push_back({ line, err });
+        }
+        values.push_back(std::move(value));
+        return true;
+    }, threads);
+    return values;
+}
+
+bool jparser::parse_ndjson_file(const std::string& path, const ndjson_callback& callback, std::string& err, unsigned threads)
+{
+    jmapping file;
+    if (!file.open(path, err))
+    {
+        return false;
+    }
+    return parse_ndjson(file.view(), callback, threads);
+}
+
+/*
+ * Returns the number of lines in `s[begin, end)`, the last one may have
+ * no newline.
+ */
+size_t jparser::parse_lines(std::string_view s, size_t begin, size_t end, std::vector<ndjson_record>& out)
+{
+    size_t line = 0;
+    jparser parser; //one for all the lines, its buffers are reused
+    for (; begin < end; ++line)
+    {
+        auto nl = static_cast<const char*>(memchr(s.data() + begin, '\n', end - begin));
+        size_t line_end = nl == nullptr ? end : nl - s.data();
+        parser.start(s, begin, line_end);
+        parser.skip_space();
+        if (parser.p != parser.e)
+        {
+            json value = parser.parse_value();
+            parser.skip_space();
+            if (parser.p != parser.e)
+            {
+                parser.fail(error::unexpected_character, parser.p);
+            }
+            std::string err;
+            if (parser.failed(err))
+            {
+                out.push_back({ line, json(), std::move(err) });
+            }
+            else
+            {
+                out.push_back({ line, std::move(value), std::string() });
+            }
+        }
+        begin = line_end + 1;
+    }
+    return line;
+}
+
+/*
+ * The file is mapped into memory and parsed in place, it is never
+ * copied into a string.
+ */
+json jparser::parse_file(const std::string& path, std::string& err) noexcept
+{
+    jmapping file;
+    if (!file.open(path, err))
+    {
+        return json::null;
+    }
+    return parse(file.view(), err);
+}
+
+bool jparser::parse_file(const std::string& path, json::document& doc, std::string& err) noexcept
+{
+    jmapping file;
+    if (!file.open(path, err))
+    {
+        doc.clear();
+        return false;
+    }
+    return parse(file.view(), doc, err);
+}
+
+/*
+ * The input is never read past `e`, it does not need to be terminated
+ * and may contain NUL bytes.
+ */
+jparser::jparser(numbers mode)
+    : s(nullptr)
+    , p(nullptr)
+    , e(nullptr)
+    , arena(nullptr)
+    , number_mode(mode)
+#ifdef MQ_JSON_FLAT_OBJECT
+    , key_table(&own_keys)
+#endif
+{
+}
+
+jparser::jparser(std::string_view s, jnode_arena* arena)
+    : jparser()
+{
+    this->arena = arena;
+    start(s, 0, s.size());
+}
+
+/*
+ * Parse only `s[begin, end)`, positions in errors are still counted from
+ * the start of `s`.
+ */
+jparser::jparser(std::string_view s, size_t begin, size_t end)
+    : jparser()
+{
+    start(s, begin, end);
+}
+
+//point the parser at `text[begin, end)`
+void jparser::start(std::string_view text, size_t begin, size_t end)
+{
+    s = text.data();
+    p = s + begin;
+    e = s + end;
+    failure = error();
+}
+
+/*
+ * Records the first error of the parse and moves `p` to the end of the
+ * input. Every loop stops there and every expected character is missing,
+ * so the callers unwind by returning without checking for errors.
+ */
+void jparser::fail(error::code_type code, const char* at)
+{
+    if (!failure)
+    {
+        failure.code = code;
+        failure.offset = at - s;
+    }
+    p = e;
+}
+
+//copies the message of the error to `err` when there is one
+bool jparser::failed(std::string& err) const
+{
+    if (!failure)
+    {
+        return false;
+    }
+    err = failure.what();
+    return true;
+}
+
+const char* jparser::error::message() const
+{
+    static const char* const messages[] =
+    {
+        "No error", "Unexpected end of input", "Unexpected character", "Expected value", "Expected string",
+        "Expected `:`", "Expected `}` or `,`", "Expected `,` or `]`", "Expected `true` or `false`",
+        "Expected string `null`", "Expected digit", "Number too big", "Duplicated key",
+        "Bad utf-16 code point", "Expected `\\uXXXX` escape sequence", "Expected 4 hexadecimal digit sequence",
+        "Invalid UTF-8"
+    };
+    return messages[code];
+}
+
+std::string jparser::error::what() const
+{
+    if (code == none || code == unexpected_end)
+    {
+        return message();
+    }
+    return message() + (" at position " + std::to_string(offset));
+}
+
+jparser::error::position jparser::error::locate(std::string_view text) const
+{
+    size_t end = std::min(offset, text.size());
+    size_t line = 1;
+    size_t line_start = 0;
+    for (size_t i = 0; i < end; i++)
+    {
+        if (text[i] == '\n')
+        {
+            ++line;
+            line_start = i + 1;
+        }
+    }
+    return{ line, end - line_start + 1 };
 }
 
 /*
@@ -42,26 +647,25 @@ jparser::jparser(const std::string& s)
  */
 json jparser::parse_value()
 {
-#define RETURN(val) if (recurHeight == 0) return val; returnValues.emplace_back(std::move(val)); recurHeight--; \
-    _addr = returnAddr.back(); returnAddr.pop_back(); \
+#define RETURN(val) if (return_stack.empty()) return val; value_stack.emplace_back(std::move(val)); \
+    _addr = return_stack.back(); return_stack.pop_back(); \
     switch(_addr) { case parse_value_object: goto VALUE_OBJECT_RETURN; case parse_value_array: goto VALUE_ARRAY_RETURN;\
     case parse_object_value: goto OBJECT_VALUE_RETURN; case parse_array_value: goto ARRAY_VALUE_RETURN; default: assert(0); } (void)0
 
 #define CALL(call_label, back_addr, back_label, assign_val) \
-    returnAddr.push_back(back_addr); recurHeight++; goto call_label; back_label: assign_val = pop_back(returnValues)
-
-    enum return_addr { parse_value_object, parse_value_array, parse_object_value, parse_array_value };
-    int recurHeight = 0;
-    std::vector<json> returnValues;
-    std::vector<return_addr> returnAddr;
-    std::vector<json::object> obj;
-    std::vector<json::array> arr;
-    auto pop_back = [](auto& vec) { auto t = vec.back(); vec.pop_back();  return t; };
+    return_stack.push_back(back_addr); goto call_label; back_label: assign_val = pop_back(value_stack)
+
+    //a parse that failed may have left them filled
+    value_stack.clear();
+    return_stack.clear();
+    object_stack.clear();
+    array_stack.clear();
+    key_stack.clear();
+    auto pop_back = [](auto& vec) { auto t = std::move(vec.back()); vec.pop_back(); return t; };
     return_addr _addr;
-    std::string str;
 PARSE_VALUE:
     skip_space();
-    if (*p == '\0')
+    if (p == e)
     {
         RETURN(json::null);
     }
@@ -82,13 +686,13 @@ PARSE_VALUE:
     case 'n':
         RETURN(parse_null());
     case '\"':
-        RETURN(parse_string());
+        RETURN(make_value(parse_string()));
     default:
         if (isdigit(*p) || *p == '-')
         {
             RETURN(parse_number());
         }
-        RETURN(json::null);
+        RETURN(json::null); //a missing value, as in `[1,]` or `{"a" : }`, is null
     }
     { //PARSE OBJECT
 PARSE_OBJECT:
@@ -96,44 +700,55 @@ PARSE_OBJECT:
         assert(*p == '{');
         ++p;
         skip_space();
-        if (*p == '}')
+        if (peek('}'))
         {
             ++p;
-            RETURN(json::object{});
+            RETURN(make_value(json::object{}));
         }
-        obj.emplace_back();
-        while (*p)
+        object_stack.emplace_back();
+        while (p != e)
         {
-            str = parse_string();
-            if (obj.back().find(str) != obj.back().end())
+            skip_space();
+            if (!peek('\"')) //also after a trailing comma, as in `{"a" : 1,}`
             {
-                throw std::runtime_error(("Duplicated key at position ") + std::to_string(p - s - str.size()));
+                fail(error::expected_string, p);
+                return json();
+            }
+            key_stack.push_back(parse_object_key());
+            if (object_stack.back().find(key_stack.back()) != object_stack.back().end())
+            {
+                fail(error::duplicated_key, p - key_stack.back().size());
+                return json();
             }
             skip_space();
-            if (*p != ':')
+            if (!peek(':'))
             {
-                throw std::runtime_error(("Expected `:` at position ") + std::to_string(p - s));
+                fail(error::expected_colon, p);
+                return json();
             }
             ++p;
             CALL(PARSE_VALUE, parse_object_value, OBJECT_VALUE_RETURN, auto val);
 
-            obj.back().emplace(std::move(str), std::move(val));
+            object_stack.back().emplace(std::move(key_stack.back()), std::move(val));
+            key_stack.pop_back();
             skip_space();
-            if (*p == ',')
+            if (peek(','))
             {
                 ++p;
             }
-            else if (*p == '}')
+            else if (peek('}'))
             {
                 ++p;
-                RETURN(pop_back(obj));
+                RETURN(make_value(pop_back(object_stack)));
             }
             else
             {
-                throw std::runtime_error(("Expected `}` or `,` at position ") + std::to_string(p - s));
+                fail(error::expected_object_end, p);
+                return json();
             }
         }
-        throw std::runtime_error(("Unexpected end of input"));
+        fail(error::unexpected_end, e);
+        return json();
     }
     { //PARSE ARRAY
 PARSE_ARRAY:
@@ -141,389 +756,935 @@ PARSE_ARRAY:
         assert(*p == '[');
         ++p;
         skip_space();
-        if (*p == ']')
+        if (peek(']'))
         {
             ++p;
-            RETURN(json::array{});
+            RETURN(make_value(json::array{}));
         }
-        arr.emplace_back();
-        while (*p)
+        array_stack.emplace_back();
+        while (p != e)
         {
             CALL(PARSE_VALUE, parse_array_value, ARRAY_VALUE_RETURN, auto _val);
-            arr.back().push_back(std::move(_val));
+            array_stack.back().push_back(std::move(_val));
             skip_space();
-            if (*p == ',')
+            if (peek(','))
             {
                 ++p;
             }
-            else if (*p == ']')
+            else if (peek(']'))
             {
                 ++p;
-                RETURN(pop_back(arr));
+                RETURN(make_value(pop_back(array_stack)));
             }
             else
             {
-                throw std::runtime_error(("Expected `,` or `]` at position ") + std::to_string(p - s));
+                fail(error::expected_array_end, p);
+                return json();
             }
         }
-        throw std::runtime_error(("Unexpected end of input"));
+        fail(error::unexpected_end, e);
+        return json();
     }
 }
 #undef CALL
 #undef RETURN
-json jparser::parse_boolean()
-{
-    skip_space();
-    if (strncmp(p, "true", 4) == 0)
-    {
-        p += 4;
-        return true;
-    }
-    if (strncmp(p, "false", 5) == 0)
-    {
-        p += 5;
-        return false;
-    }
-    throw std::runtime_error(("Expected `true` or `false` at position ") + std::to_string(p - s));
-}
 
-std::string jparser::parse_string()
+/*
+ * The grammar of `parse_value`, but only the kinds of the open containers
+ * are kept, `{` or `[` in `nesting`. Nothing is allocated per value.
+ * Duplicated keys are not detected since keys are not kept either.
+ */
+bool jparser::parse_events(jhandler& handler)
 {
-    skip_space();
-    assert(*p == '\"');
-    ++p;
-    if (*p == '\"')
+    std::vector<char> nesting;
+    auto parse_key = [&]
     {
+        std::string_view key = parse_string_view();
+        skip_space();
+        if (!peek(':')) //also after a failure, it leaves `p` at the end
+        {
+            fail(error::expected_colon, p);
+            return false;
+        }
         ++p;
-        return{};
-    }
-    std::string str;
-    while (*p)
+        return handler.on_key(key);
+    };
+    for (;;)
     {
-        if (*p == '\\')
+        skip_space();
+        if (p == e)
+        {
+            if (!nesting.empty())
+            {
+                fail(error::unexpected_end, e);
+                return false;
+            }
+            return handler.on_null();
+        }
+        bool go_on;
+        switch (*p)
         {
+        case '{':
             ++p;
-            switch (*p)
+            if (!handler.on_start_object())
             {
-            case'\"':
-                ++p;
-                str.push_back('\"');
-                continue;
-            case '\\':
-                ++p;
-                str.push_back('\\');
-                continue;
-            case '/':
-                ++p;
-                str.push_back('/');
-                continue;
-            case 'b':
-                ++p;
-                str.push_back('\b');
-                continue;
-            case 'f':
-                ++p;
-                str.push_back('\f');
-                continue;
-            case 'n':
-                ++p;
-                str.push_back('\n');
-                continue;
-            case 'r':
-                ++p;
-                str.push_back('\r');
-                continue;
-            case 't':
-                ++p;
-                str.push_back('\t');
+                return false;
+            }
+            skip_space();
+            if (!peek('}'))
+            {
+                nesting.push_back('{');
+                if (!parse_key())
+                {
+                    return false;
+                }
                 continue;
-            case 'u':
-                --p; //step back, give full `\uXXXX` sequence to parse function, for loop invariance
-                str += parse_utf16_escape_sequence();
+            }
+            ++p;
+            go_on = handler.on_end_object();
+            break;
+        case '[':
+            ++p;
+            if (!handler.on_start_array())
+            {
+                return false;
+            }
+            skip_space();
+            if (!peek(']'))
+            {
+                nesting.push_back('[');
                 continue;
-            default:; //fall through
             }
+            ++p;
+            go_on = handler.on_end_array();
+            break;
+        case 't': case 'f':
+        {
+            bool b = parse_boolean().as_bool();
+            go_on = !failure && handler.on_bool(b);
+            break;
         }
-        if (*p == '\"')
+        case 'n':
+            parse_null();
+            go_on = !failure && handler.on_null();
+            break;
+        case '\"':
         {
-            ++p;
-            return str;
+            std::string_view str = parse_string_view();
+            go_on = !failure && handler.on_string(str);
+            break;
+        }
+        default:
+            if (isdigit(*p) || *p == '-')
+            {
+                json number = parse_number(); //a scalar, kept inline
+                go_on = !failure && (number._tag == json::tag::integer ? handler.on_int64(number._v.i) : handler.on_double(number._v.d));
+                break;
+            }
+            go_on = handler.on_null();
+        }
+        if (!go_on)
+        {
+            return false;
         }
-        else
+        //a value is complete, close the containers it ends
+        for (;;)
         {
-            str.push_back(*p);
+            if (nesting.empty())
+            {
+                return true;
+            }
+            bool in_object = nesting.back() == '{';
+            skip_space();
+            if (peek(','))
+            {
+                ++p;
+                if (in_object && !parse_key())
+                {
+                    return false;
+                }
+                break;
+            }
+            if (!peek(in_object ? '}' : ']'))
+            {
+                if (p == e)
+                {
+                    fail(error::unexpected_end, e);
+                    return false;
+                }
+                fail(in_object ? error::expected_object_end : error::expected_array_end, p);
+                return false;
+            }
             ++p;
+            nesting.pop_back();
+            if (!(in_object ? handler.on_end_object() : handler.on_end_array()))
+            {
+                return false;
+            }
         }
     }
-    throw std::runtime_error(("Unexpected end of input"));
 }
-
-json jparser::parse_object()
+/*
+ * The elements of an array without the brackets, up to `e`. The range
+ * holds at least one element, as `parse_value` reads a missing one as
+ * null, unless it is the `whole` array and only has spaces.
+ */
+void jparser::parse_elements(json::array& arr, bool whole)
 {
     skip_space();
-    assert(*p == '{');
-    ++p;
-    json::object obj;
+    if (p == e && whole)
+    {
+        return;
+    }
+    for (;;)
+    {
+        arr.push_back(parse_value());
+        skip_space();
+        if (p == e)
+        {
+            return;
+        }
+        if (!peek(','))
+        {
+            fail(error::expected_array_end, p);
+            return;
+        }
+        ++p;
+    }
+}
+
+/*
+ * The members of an object without the braces, up to `e`. Like in
+ * `parse_value` a comma must be followed by a key, so only the `whole`
+ * object may be empty.
+ */
+void jparser::parse_members(json::object& obj, bool whole)
+{
     skip_space();
-    if (*p == '}')
+    if (p == e && whole)
     {
-        ++p;
-        return obj;
+        return;
     }
-    while (*p)
+    for (;;)
     {
-        auto str = parse_string();
-        if (obj.find(str) != obj.end())
+        if (!peek('\"'))
         {
-            throw std::runtime_error(("Duplicated key at position ") + std::to_string(p - s - str.size()));
+            fail(error::expected_string, p);
+            return;
         }
-        skip_space();
-        if (*p != ':')
+        json::object::key_type key = parse_object_key();
+        if (obj.find(key) != obj.end())
         {
-            throw std::runtime_error(("Expected `:` at position ") + std::to_string(p - s));
+            fail(error::duplicated_key, p - key.size());
+            return;
         }
-        ++p;
-        auto val = parse_value();
-        obj.emplace(std::move(str), std::move(val));
         skip_space();
-        if (*p == ',')
+        if (!peek(':'))
         {
-            ++p;
+            fail(error::expected_colon, p);
+            return;
         }
-        else if (*p == '}')
+        ++p;
+        obj.emplace(std::move(key), parse_value());
+        skip_space();
+        if (p == e)
         {
-            ++p;
-            return obj;
+            return;
         }
-        else
+        if (!peek(','))
         {
-            throw std::runtime_error(("Expected `}` or `,` at position ") + std::to_string(p - s));
+            fail(error::expected_object_end, p);
+            return;
         }
+        ++p;
+        skip_space();
     }
-    throw std::runtime_error(("Unexpected end of input"));
 }
 
-json jparser::parse_null()
+json jparser::parse_boolean()
 {
-    if (strncmp(p, "null", 4) == 0)
+    skip_space();
+    if (match("true", 4))
     {
         p += 4;
-        return json::null;
+        return true;
+    }
+    if (match("false", 5))
+    {
+        p += 5;
+        return false;
     }
-    throw std::runtime_error(("Expected string `null` at position ") + std::to_string(p - s));
+    fail(error::expected_boolean, p);
+    return json();
 }
 
-json jparser::parse_array()
+std::string jparser::parse_string()
 {
     skip_space();
-    json::array arr;
-    assert(*p == '[');
-    ++p;
+    assert(*p == '\"');
+    const char* begin = ++p;
+    p = jscanner::find_quote_or_backslash(p, e);
+    if (peek('\"'))
+    {
+        ++p;
+        return std::string(begin, p - 1 - begin); //no escape, one allocation of the exact size
+    }
+    std::string str(begin, p - begin);
+    parse_escaped_rest(str);
+    return str;
+}
+
+/*
+ * A string without escapes is returned as a view into the input, an
+ * escaped one is decoded into `scratch` and the view is valid until the
+ * next call.
+ */
+std::string_view jparser::parse_string_view()
+{
     skip_space();
-    if (*p == ']')
+    if (!peek('\"'))
+    {
+        fail(error::expected_string, p);
+        return std::string_view();
+    }
+    const char* begin = ++p;
+    p = jscanner::find_quote_or_backslash(p, e);
+    if (peek('\"'))
     {
         ++p;
-        return arr;
+        return std::string_view(begin, p - 1 - begin);
     }
-    while (*p)
+    scratch.assign(begin, p);
+    parse_escaped_rest(scratch);
+    return scratch;
+}
+
+/*
+ * `p` is at a backslash or at the end of the input. Decodes the rest of
+ * the string into `str`, the runs between escapes are appended at once,
+ * and steps over the closing quote.
+ */
+void jparser::parse_escaped_rest(std::string& str)
+{
+    while (p != e)
     {
-        arr.push_back(parse_value());
-        skip_space();
-        if (*p == ',')
-        {
-            ++p;
-        }
-        else if (*p == ']')
+        if (*p == '\"')
         {
             ++p;
-            return arr;
-        }
-        else
-        {
-            throw std::runtime_error(("Expected `,` or `]` at position ") + std::to_string(p - s));
+            return;
         }
+        parse_escape(str);
+        const char* run = p;
+        p = jscanner::find_quote_or_backslash(p, e);
+        str.append(run, p - run);
     }
-    throw std::runtime_error(("Unexpected end of input"));
+    fail(error::unexpected_end, e);
+    return;
 }
 
-json jparser::parse_number()
+/*
+ * With flat objects, every key is interned so that all the objects of a
+ * document, or of every document parsed with the same table, share them,
+ * unless `intern_keys(false)` turned it off.
+ */
+json::object::key_type jparser::parse_object_key()
+{
+#ifdef MQ_JSON_FLAT_OBJECT
+    std::string_view key = parse_string_view();
+    return key_table != nullptr ? key_table->intern(key) : jkey(key);
+#else
+    return std::string(parse_string_view());
+#endif
+}
+
+/*
+ * `p` is at a backslash, the escape sequence is decoded and appended to `str`
+ */
+void jparser::parse_escape(std::string& str)
+{
+    ++p;
+    if (p == e)
+    {
+        fail(error::unexpected_end, e);
+        return;
+    }
+    switch (*p)
+    {
+    case 'b':
+        str.push_back('\b');
+        break;
+    case 'f':
+        str.push_back('\f');
+        break;
+    case 'n':
+        str.push_back('\n');
+        break;
+    case 'r':
+        str.push_back('\r');
+        break;
+    case 't':
+        str.push_back('\t');
+        break;
+    case 'u':
+        --p; //step back, give full `\uXXXX` sequence to parse function
+        parse_utf16_escape_sequence(str);
+        return;
+    default: //`"`, `\`, `/`, any other character stands for itself
+        str.push_back(*p);
+    }
+    ++p;
+}
+
+json jparser::parse_null()
+{
+    if (match("null", 4))
+    {
+        p += 4;
+        return json::null;
+    }
+    fail(error::expected_null, p);
+    return json();
+}
+
+namespace
+{
+//locale independent, unlike `isdigit`
+inline bool is_digit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+//the powers of ten a double holds exactly
+const double exact_powers_of_ten[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+}
+
+/*
+ * The grammar of a number, from `p` on. Nothing is converted, the digits
+ * are only gathered into `n`; `p` is left at the number.
+ */
+bool jparser::scan_number(number_scan& n)
 {
-    skip_space();
     const char* c = p;
-    char* e;
-    if (*c == '-')
+    n.negative = c != e && *c == '-';
+    if (n.negative)
     {
         ++c;
     }
-    if (*c == '0')
+    n.mantissa = 0;
+    n.digits = 0;
+    if (c != e && *c == '0')
     {
         ++c;
     }
-    else if (isdigit(*c)) //1-9
+    else if (c != e && is_digit(*c)) //1-9
     {
         do
         {
+            n.mantissa = n.mantissa * 10 + (*c - '0');
+            ++n.digits;
             ++c;
-        } while (isdigit(*c));
+        } while (c != e && is_digit(*c));
     }
     else
     {
-        throw std::runtime_error(("Expected digit at position ") + std::to_string(c - s));
-    }
-    if (*c != '.' && *c != 'e' && *c != 'E')
-    {
-        errno = 0;
-        int64_t integer = std::strtoll(p, &e, 10);
-        if (errno != ERANGE)
-        {
-            p = e;
-            return integer;
-        }
+        fail(error::expected_digit, c);
+        return false;
     }
-    if (*c == '.')
+    n.integral = c == e || (*c != '.' && *c != 'e' && *c != 'E');
+    n.exponent = 0;
+    if (c != e && *c == '.')
     {
         ++c;
-        if (!isdigit(*c))
+        if (c == e || !is_digit(*c))
         {
-            throw std::runtime_error(("Expected digit at position ") + std::to_string(c - s));
+            fail(error::expected_digit, c);
+            return false;
         }
-        for (++c; isdigit(*c); ++c);
+        const char* fraction = c;
+        do
+        {
+            n.mantissa = n.mantissa * 10 + (*c - '0');
+            ++c;
+        } while (c != e && is_digit(*c));
+        n.digits += c - fraction;
+        n.exponent = fraction - c;
     }
-    if (*c == 'e' || *c == 'E')
+    if (c != e && (*c == 'e' || *c == 'E'))
     {
         ++c;
-        if (*c == '-' || *c == '+')
+        bool negative_exponent = c != e && *c == '-';
+        if (c != e && (*c == '-' || *c == '+'))
         {
             ++c;
         }
-        if (!isdigit(*c))
+        if (c == e || !is_digit(*c))
         {
-            throw std::runtime_error(("Expected digit at position ") + std::to_string(c - s));
+            fail(error::expected_digit, c);
+            return false;
         }
+        int64_t written = 0;
         do
         {
+            if (written < 1000000) //far out of range already, only consume the rest
+            {
+                written = written * 10 + (*c - '0');
+            }
             ++c;
-        } while (isdigit(*c));
+        } while (c != e && is_digit(*c));
+        n.exponent += negative_exponent ? -written : written;
+    }
+    n.end = c;
+    return true;
+}
+
+bool jparser::number_scan::is_int64() const
+{
+    return integral && digits <= 19 && (mantissa <= static_cast<uint64_t>(INT64_MAX) || (negative && mantissa == static_cast<uint64_t>(INT64_MAX) + 1));
+}
+
+//a double is exact when both the mantissa and the power of ten are
+bool jparser::number_scan::is_exact_double() const
+{
+    return digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22;
+}
+
+/*
+ * The digits are read once, into a 64 bit mantissa and a decimal
+ * exponent. Integers that fit in int64_t are returned from them. So are
+ * doubles whose mantissa and power of ten are both exact doubles, as the
+ * one rounding of the product or quotient is then correctly rounded.
+ * The rest go to `std::from_chars`, which is exact too. None of it
+ * depends on the locale.
+ */
+json jparser::parse_number()
+{
+    skip_space();
+    number_scan n;
+    if (!scan_number(n))
+    {
+        return json();
     }
-    errno = 0;
-    double fraction = std::strtod(p, &e);
-    if (errno == ERANGE)
+    if (n.is_int64())
     {
-        throw std::runtime_error(("Number too big at position ") + std::to_string(e - s));
+        p = n.end;
+        return static_cast<int64_t>(n.negative ? 0 - n.mantissa : n.mantissa); //-2^63 wraps to INT64_MIN
     }
-    p = e;
+    //an integer too big for int64_t falls through and becomes a double
+    if (number_mode == numbers::keep_text && (n.integral || n.digits > 15))
+    {
+        return make_number_text(n.end); //more digits than a double keeps
+    }
+    if (n.is_exact_double())
+    {
+        double fraction = static_cast<double>(n.mantissa);
+        fraction = n.exponent < 0 ? fraction / exact_powers_of_ten[-n.exponent] : fraction * exact_powers_of_ten[n.exponent];
+        p = n.end;
+        return n.negative ? -fraction : fraction;
+    }
+    double fraction;
+    if (std::from_chars(p, n.end, fraction).ec == std::errc::result_out_of_range)
+    {
+        if (number_mode == numbers::keep_text)
+        {
+            return make_number_text(n.end);
+        }
+        fail(error::number_too_big, n.end);
+        return json();
+    }
+    p = n.end;
     return fraction;
 }
 
 /*
- * Use `c16rtomb` to convert utf16 sequence to utf-8
+ * Decodes one `\uXXXX` escape, or a pair of them for a character outside
+ * the basic plane, straight into `str`. Nothing is kept between calls.
  */
-std::string jparser::parse_utf16_escape_sequence()
+void jparser::parse_utf16_escape_sequence(std::string& str)
 {
-    std::string str;
-    uint16_t char16;
-    size_t convSize;
-    do //this loop will loop for at most 2 cycles
+    uint32_t unit = read_utf16_escape();
+    if (jutf8::is_high_surrogate(unit))
     {
-        if (strncmp(p, "\\u", 2) != 0)
+        uint32_t low = read_utf16_escape();
+        if (!jutf8::is_low_surrogate(low))
         {
-            throw std::runtime_error("Expected `\\uXXXX` escape sequence at position " + std::to_string((p - s)));
-        }
-        p += 2;
-        if (sscanf(p, "%04hx", &char16) != 1)
-        {
-            throw std::runtime_error("Expected 4 hexadecimal digit sequence at position " + std::to_string((p - s)));
+            fail(error::bad_utf16, p - 4);
+            return;
         }
+        unit = jutf8::combine(unit, low);
+    }
+    jutf8::append(unit, str);
+}
 
-        convSize = utf16_to_utf8(char16, str);
+uint16_t jparser::read_utf16_escape()
+{
+    if (!match("\\u", 2))
+    {
+        fail(error::expected_utf16_escape, p);
+        return 0;
+    }
+    p += 2;
+    uint32_t unit;
+    if (e - p < 4 || !jutf8::read_hex4(p, unit))
+    {
+        fail(error::expected_hex, p);
+        return 0;
+    }
+    p += 4;
+    return static_cast<uint16_t>(unit);
+}
 
-        if (convSize == static_cast<size_t>(-1))
-        {
-            throw std::runtime_error("Bad utf-16 code point at position " + std::to_string(p - s));
-        }
-        p += 4;
-    } while (convSize == 0); // convSize == 0, meet multibyte utf-16 char, continue loop for next
-    return str; //copy to return
+json jparser::make_value(std::string&& s)
+{
+    if (arena == nullptr)
+    {
+        return std::move(s);
+    }
+    return json::borrow(jvalue::string_instance(std::move(s), *arena));
 }
 
-/*
- * This is a modified version of MSCRT's c16rtomb.cpp
- */
-size_t jparser::utf16_to_utf8(char16_t c16, std::string& s)
+//the number from `p` to `end`, which has been checked already
+json jparser::make_number_text(const char* end)
 {
-    int nextra;
+    std::string_view text(p, end - p);
+    p = end;
+    if (arena == nullptr)
+    {
+        return json(jvalue::number_instance(text));
+    }
+    return json::borrow(jvalue::number_instance(text, *arena));
+}
 
-    static struct internal_state_t
+json jparser::make_value(json::object&& o)
+{
+    if (arena == nullptr)
     {
-        unsigned long _wchar;
-        unsigned short _byte, _state;
-    } pst{};
+        return std::move(o);
+    }
+    return json::borrow(jvalue::object_instance(std::move(o), *arena));
+}
 
-    char state = static_cast<char>(pst._state); /* number of extra words expected */
-    unsigned long wc = pst._wchar; /* cumulative character */
+json jparser::make_value(json::array&& a)
+{
+    if (arena == nullptr)
+    {
+        return std::move(a);
+    }
+    return json::borrow(jvalue::array_instance(std::move(a), *arena));
+}
 
-    if (state != 0)
-    { /* fold in second word and convert */
-        if (c16 < 0xdc00 || 0xe000 <= c16)
+/*
+ * Most runs of spaces are one byte, after a colon or a comma, and the
+ * scanner is only called for the longer ones of indented text.
+ */
+void jparser::skip_space()
+{
+    auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+    if (p != e && is_space(*p))
+    {
+        ++p;
+        if (p != e && is_space(*p))
         {
-            pst = {};
-            return static_cast<size_t>(-1); /* invalid second word */
+            p = jscanner::find_non_space(p, e);
         }
-        pst._state = 0;
-        wc |= static_cast<unsigned long>(c16 - 0xdc00);
     }
-    else if (c16 < 0xd800 || 0xdc00 <= c16)
+}
+
+bool jparser::peek(char c) const
+{
+    return p != e && *p == c;
+}
+
+bool jparser::match(const char* literal, size_t len) const
+{
+    return static_cast<size_t>(e - p) >= len && memcmp(p, literal, len) == 0;
+}
+
+/*
+ * The grammar of `parse_value`, step by step, with `parse_string_view`,
+ * `scan_number`, `parse_boolean` and `parse_null` for the scalars. The
+ * open containers are kept as bits, set for an object; the first 4096
+ * levels need no allocation.
+ */
+void jparser::validate_text()
+{
+    uint64_t nesting[64];
+    std::vector<uint64_t> deeper;
+    size_t depth = 0;
+    auto word = [&](size_t d) -> uint64_t&
     {
-        wc = static_cast<unsigned long>(c16); /* not first word */
-    }
-    else
-    { /* save value bits of first word for later */
-        pst._state = 1;
-        pst._wchar = static_cast<unsigned long>((c16 - 0xd800 + 0x0040) << 10);
-        return (0);
+        return d / 64 < 64 ? nesting[d / 64] : deeper[d / 64 - 64];
+    };
+    auto open = [&](bool is_object)
+    {
+        if (depth / 64 >= 64 + deeper.size())
+        {
+            deeper.push_back(0);
+        }
+        uint64_t bit = uint64_t(1) << (depth % 64);
+        word(depth) = is_object ? word(depth) | bit : word(depth) & ~bit;
+        ++depth;
+        if (is_object)
+        {
+            open_objects.push_back({ validated_keys.size(), decoded_keys.size() });
+            if (key_indexes.size() < open_objects.size())
+            {
+                key_indexes.emplace_back();
+            }
+        }
+    };
+    auto close = [&](bool is_object)
+    {
+        --depth;
+        if (is_object)
+        {
+            validated_keys.resize(open_objects.back().first_key);
+            decoded_keys.resize(open_objects.back().first_decoded);
+            key_indexes[open_objects.size() - 1].clear();
+            open_objects.pop_back();
+        }
+    };
+    for (;;)
+    {
+        skip_space();
+        if (p != e) //else null, as after `[1,`
+        {
+            switch (*p)
+            {
+            case '{':
+                ++p;
+                skip_space();
+                if (peek('}'))
+                {
+                    ++p;
+                    break;
+                }
+                open(true);
+                if (p == e)
+                {
+                    fail(error::unexpected_end, e);
+                    return;
+                }
+                if (!validate_key())
+                {
+                    return;
+                }
+                continue;
+            case '[':
+                ++p;
+                skip_space();
+                if (peek(']'))
+                {
+                    ++p;
+                    break;
+                }
+                open(false);
+                if (p == e)
+                {
+                    fail(error::unexpected_end, e);
+                    return;
+                }
+                continue;
+            case 't': case 'f':
+                parse_boolean();
+                break;
+            case 'n':
+                parse_null();
+                break;
+            case '\"':
+                validate_string();
+                break;
+            default:
+                if (is_digit(*p) || *p == '-')
+                {
+                    validate_number();
+                } //anything else is a null that takes no character
+            }
+        }
+        if (failure)
+        {
+            return;
+        }
+        //a value is complete, close the containers it ends
+        for (;;)
+        {
+            if (depth == 0)
+            {
+                return; //what follows the value is not looked at
+            }
+            bool in_object = (word(depth - 1) >> ((depth - 1) % 64) & 1) != 0;
+            skip_space();
+            if (peek(','))
+            {
+                ++p;
+                if (p == e)
+                {
+                    fail(error::unexpected_end, e);
+                    return;
+                }
+                if (in_object && !validate_key())
+                {
+                    return;
+                }
+                break;
+            }
+            if (!peek(in_object ? '}' : ']'))
+            {
+                fail(in_object ? error::expected_object_end : error::expected_array_end, p);
+                return;
+            }
+            ++p;
+            close(in_object);
+        }
     }
+}
 
-    if ((wc & ~0x7fUL) == 0)
-    { /* generate a single byte */
-        s += static_cast<unsigned char>(wc);
-        nextra = 0;
-    }
-    else if ((wc & ~0x7ffUL) == 0)
-    { /* generate two bytes */
-        s += static_cast<unsigned char>(0xc0 | wc >> 6);
-        nextra = 1;
+//a key of the innermost object and its colon, the value follows
+bool jparser::validate_key()
+{
+    skip_space();
+    if (!peek('\"'))
+    {
+        fail(error::expected_string, p);
+        return false;
     }
-    else if ((wc & ~0xffffUL) == 0)
-    { /* generate three bytes */
-        s += static_cast<unsigned char>(0xe0 | wc >> 12);
-        nextra = 2;
+    const char* begin = p;
+    std::string_view key = validate_string();
+    //an escape is longer than what it stands for
+    if (failure || !add_validated_key(key, static_cast<size_t>(p - begin) != key.size() + 2))
+    {
+        return false;
     }
-    else if ((wc & ~0x1fffffUL) == 0)
-    { /* generate four bytes */
-        s += static_cast<unsigned char>(0xf0 | wc >> 18);
-        nextra = 3;
+    skip_space();
+    if (!peek(':'))
+    {
+        fail(error::expected_colon, p);
+        return false;
     }
-    else if ((wc & ~0x3ffffffUL) == 0)
-    { /* generate five bytes */
-        s += static_cast<unsigned char>(0xf8 | wc >> 24);
-        nextra = 4;
+    ++p;
+    return true;
+}
+
+/*
+ * `parse_string_view`, then the raw bytes between the quotes must be
+ * valid UTF-8. ASCII is skipped 16 bytes at a time.
+ */
+std::string_view jparser::validate_string()
+{
+    const char* begin = p + 1;
+    std::string_view str = parse_string_view();
+    if (failure)
+    {
+        return str;
     }
-    else
-    { /* generate six bytes */
-        s += static_cast<unsigned char>(0xfc | ((wc >> 30) & 0x03));
-        nextra = 5;
+    const char* end = p - 1; //the closing quote
+    for (const char* c = jscanner::find_non_ascii(begin, end); c != end; c = jscanner::find_non_ascii(c, end))
+    {
+        size_t n = jutf8::sequence_length(c, end);
+        if (n == 0)
+        {
+            fail(error::bad_utf8, c);
+            break;
+        }
+        c += n;
     }
+    return str;
+}
 
-    for (int i = nextra; i > 0; --i)
+//`parse_number` without the conversion, only a number too big fails
+void jparser::validate_number()
+{
+    number_scan n;
+    if (!scan_number(n))
+    {
+        return;
+    }
+    if (!n.is_int64() && !n.is_exact_double())
     {
-        s += static_cast<unsigned char>(0x80 | ((wc >> 6 * (i - 1)) & 0x3f));
+        double fraction;
+        if (std::from_chars(p, n.end, fraction).ec == std::errc::result_out_of_range)
+        {
+            fail(error::number_too_big, n.end);
+            return;
+        }
     }
-    return nextra + 1;
+    p = n.end;
 }
 
-void jparser::skip_space()
+/*
+ * Fails like `parse_value` when the innermost object has `key` already.
+ * Its keys are searched one by one, or once it has more than a few, in
+ * an open addressing index of their positions.
+ */
+bool jparser::add_validated_key(std::string_view key, bool decoded)
 {
-    for (; *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'; ++p);
+    const size_t linear_limit = 16;
+    const open_object& object = open_objects.back();
+    std::vector<uint32_t>& index = key_indexes[open_objects.size() - 1];
+    auto view = [this](const validated_key& k)
+    {
+        return k.decoded ? std::string_view(decoded_keys).substr(k.offset, k.size) : std::string_view(s + k.offset, k.size);
+    };
+    auto duplicated = [&]
+    {
+        fail(error::duplicated_key, p - key.size());
+        return false;
+    };
+    size_t count = validated_keys.size() - object.first_key;
+    size_t h = 0;
+    if (count < linear_limit)
+    {
+        for (size_t i = object.first_key; i < validated_keys.size(); i++)
+        {
+            if (view(validated_keys[i]) == key)
+            {
+                return duplicated();
+            }
+        }
+    }
+    else
+    {
+        if ((count + 1) * 2 > index.size()) //at most half full
+        {
+            size_t n = 32;
+            while (n < (count + 1) * 4)
+            {
+                n *= 2;
+            }
+            index.assign(n, 0);
+            for (size_t i = object.first_key; i < validated_keys.size(); i++)
+            {
+                size_t slot = std::hash<std::string_view>()(view(validated_keys[i])) & (n - 1);
+                while (index[slot] != 0)
+                {
+                    slot = (slot + 1) & (n - 1);
+                }
+                index[slot] = static_cast<uint32_t>(i - object.first_key + 1);
+            }
+        }
+        h = std::hash<std::string_view>()(key) & (index.size() - 1);
+        for (; index[h] != 0; h = (h + 1) & (index.size() - 1))
+        {
+            if (view(validated_keys[object.first_key + index[h] - 1]) == key)
+            {
+                return duplicated();
+            }
+        }
+        index[h] = static_cast<uint32_t>(count + 1);
+    }
+    if (decoded) //it is in `scratch`, which the next escaped string overwrites
+    {
+        validated_keys.push_back({ decoded_keys.size(), key.size(), true });
+        decoded_keys.append(key);
+    }
+    else
+    {
+        validated_keys.push_back({ static_cast<size_t>(key.data() - s), key.size(), false });
+    }
+    return true;
 }
 
 }
@@ -1,32 +1,215 @@
 #pragma once
 
 #include "json.h"
+#include "jhandler.h"
+#include <functional>
+#include <string_view>
+#include <vector>
 namespace mq
 {
 
 class jparser
 {
+    friend class jstream_parser;
 public:
-    static json parse(const std::string& s, std::string& err) noexcept;
-    static json parse(const std::string& s) noexcept;
+    //how numbers are parsed that neither int64_t nor double holds exactly
+    enum class numbers
+    {
+        convert, //to the nearest double, out of its range they are errors
+        keep_text //kept as their text, `dump` writes it back unchanged, `as_int` and `as_double` convert it
+    };
+
+    /*
+     * Why and where a parse failed. Nothing is thrown while parsing: the
+     * first error is recorded and the parser unwinds by returning. The
+     * line and column are only counted when asked for.
+     */
+    struct error
+    {
+        enum code_type : uint8_t
+        {
+            none, unexpected_end, unexpected_character, expected_value, expected_string, expected_colon,
+            expected_object_end, expected_array_end, expected_boolean, expected_null, expected_digit,
+            number_too_big, duplicated_key, bad_utf16, expected_utf16_escape, expected_hex,
+            bad_utf8 //only found by `validate`
+        };
+        struct position
+        {
+            size_t line; //from 1
+            size_t column; //from 1, in bytes
+        };
+
+        code_type code = none;
+        size_t offset = 0; //in bytes from the start of the text
+
+        explicit operator bool() const
+        {
+            return code != none;
+        }
+        const char* message() const;
+        std::string what() const; //the message with the offset, as the `err` of `parse`
+        position locate(std::string_view text) const; //`text` is the parsed one
+    };
+    struct result
+    {
+        json value; //null when parsing failed
+        error err;
+
+        explicit operator bool() const
+        {
+            return !err;
+        }
+    };
+
+    static result try_parse(std::string_view s) noexcept;
+
+    /*
+     * The error `try_parse(s)` would return, without building the value.
+     * It follows the grammar of `parse` with its leniencies: a missing
+     * value is null, as in `[1,]` or an empty text, and what follows the
+     * value is not looked at. The one difference is that the raw bytes of
+     * strings and keys must be valid UTF-8, or it fails with `bad_utf8`
+     * where `parse` accepts them. Only the keys of the open objects are
+     * kept, those without escapes as positions in `s`.
+     */
+    static error validate(std::string_view s) noexcept;
+    static json parse(std::string_view s, std::string& err) noexcept; //`try_parse` with the error as a message
+    static json parse(std::string_view s, numbers mode, std::string& err) noexcept;
+    static json parse(std::string_view s) noexcept;
+#ifdef MQ_JSON_FLAT_OBJECT
+    static json parse(std::string_view s, jkey_table& keys, std::string& err) noexcept; //the documents share the keys in `keys`
+#endif
+    static json parse(const char* s, size_t len, std::string& err) noexcept;
+    static json parse(const char* s, size_t len) noexcept;
+    static bool parse(std::string_view s, json::document& doc, std::string& err) noexcept;
+    static bool parse(std::string_view s, jhandler& handler, std::string& err) noexcept;
+    static json parse_parallel(std::string_view s, std::string& err, unsigned threads = 0) noexcept;
+
+    /*
+     * Newline delimited JSON, one value per line, blank lines are skipped.
+     * `line` counts from 1, `err` is empty unless the line failed to parse,
+     * then `value` is null. Returning false from the callback stops.
+     * A batch of lines that runs out of memory is one "Out of memory"
+     * error on its first line, its other lines are not reported.
+     */
+    using ndjson_callback = std::function<bool(size_t line, json&& value, const std::string& err)>;
+    struct line_error
+    {
+        size_t line;
+        std::string err;
+    };
+    static bool parse_ndjson(std::string_view s, const ndjson_callback& callback, unsigned threads = 0);
+    static std::vector<json> parse_ndjson(std::string_view s, std::vector<line_error>& errors, unsigned threads = 0);
+    static bool parse_ndjson_file(const std::string& path, const ndjson_callback& callback, std::string& err, unsigned threads = 0);
+    static json parse_file(const std::string& path, std::string& err) noexcept;
+    static bool parse_file(const std::string& path, json::document& doc, std::string& err) noexcept;
+
+    /*
+     * A parser kept for many documents, one per thread, keeps the memory of
+     * its stacks and string scratch space between them. So
+     * does a `json::document` read again, for its arena block.
+     */
+    explicit jparser(numbers mode = numbers::convert);
+    jparser(const jparser&) = delete;
+    jparser& operator=(const jparser&) = delete;
+    result try_read(std::string_view s) noexcept;
+    json read(std::string_view s, std::string& err) noexcept;
+    bool read(std::string_view s, json::document& doc, std::string& err) noexcept;
+#ifdef MQ_JSON_FLAT_OBJECT
+    //on by default; off, every key read is a string of its own
+    void intern_keys(bool on);
+#endif
 private:
-    jparser(const std::string& s);
+    struct ndjson_record;
+    static size_t parse_lines(std::string_view s, size_t begin, size_t end, std::vector<ndjson_record>& out);
+
+    jparser(std::string_view s, jnode_arena* arena);
+    jparser(std::string_view s, size_t begin, size_t end);
+    void start(std::string_view text, size_t begin, size_t end);
+    void fail(error::code_type code, const char* at);
+    bool failed(std::string& err) const;
 
     json parse_value();
+    bool parse_events(jhandler& handler);
+    void parse_elements(json::array& arr, bool whole);
+    void parse_members(json::object& obj, bool whole);
     json parse_boolean();
     std::string parse_string();
-    json parse_object();
+    std::string_view parse_string_view();
+    void parse_escaped_rest(std::string& str);
+    json::object::key_type parse_object_key();
+    void parse_escape(std::string& str);
     json parse_null();
-    json parse_array();
     json parse_number();
 
-    std::string parse_utf16_escape_sequence();
+    struct number_scan
+    {
+        const char* end;
+        uint64_t mantissa; //wrapped around past 19 digits
+        size_t digits;
+        int64_t exponent; //of ten, applied to the mantissa
+        bool negative;
+        bool integral; //no fraction nor exponent
+
+        bool is_int64() const;
+        bool is_exact_double() const;
+    };
+    bool scan_number(number_scan& n);
+
+    struct validated_key
+    {
+        size_t offset; //in the text, or in `decoded_keys` when the key has escapes
+        size_t size;
+        bool decoded;
+    };
+    struct open_object
+    {
+        size_t first_key; //in `validated_keys`
+        size_t first_decoded; //in `decoded_keys`
+    };
+    void validate_text();
+    bool validate_key();
+    std::string_view validate_string();
+    void validate_number();
+    bool add_validated_key(std::string_view key, bool decoded);
 
-    static size_t utf16_to_utf8(char16_t ch, std::string& s);
+    void parse_utf16_escape_sequence(std::string& str);
+    uint16_t read_utf16_escape();
+
+    json make_value(std::string&& s);
+    json make_value(json::object&& o);
+    json make_value(json::array&& a);
+    json make_number_text(const char* end);
 
     void skip_space();
+    bool peek(char c) const;
+    bool match(const char* literal, size_t len) const;
     const char* s;
     const char* p;
+    const char* e;
+    jnode_arena* arena; //values are placed in it when it is not null
+    numbers number_mode;
+    error failure; //the first error of the current parse
+    std::string scratch; //escaped strings given to a `jhandler` are decoded here
+
+    //the explicit stacks of `parse_value`, their memory is kept for the next parse
+    enum return_addr { parse_value_object, parse_value_array, parse_object_value, parse_array_value };
+    std::vector<json> value_stack; //the values returned to the open containers
+    std::vector<return_addr> return_stack;
+    std::vector<json::object> object_stack;
+    std::vector<json::array> array_stack;
+    std::vector<json::object::key_type> key_stack; //one pending key per open object
+
+    //the keys of the objects `validate` has open, for duplicated keys
+    std::vector<validated_key> validated_keys;
+    std::string decoded_keys;
+    std::vector<open_object> open_objects;
+    std::vector<std::vector<uint32_t>> key_indexes; //one per open object, built past a few keys
+#ifdef MQ_JSON_FLAT_OBJECT
+    static const size_t max_kept_keys = 1 << 12;
+    jkey_table own_keys;
+    jkey_table* key_table; //`own_keys` unless a table is shared by several parses, null when keys are not interned
+#endif
 };
 
 }
\ No newline at end of file
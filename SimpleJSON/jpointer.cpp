@@ -0,0 +1,159 @@
+#include "jpointer.h"
+#include <stdexcept>
+namespace mq
+{
+
+jpointer::jpointer(std::string_view pointer)
+    : _text(pointer)
+{
+    if (pointer.empty())
+    {
+        return; //the whole document
+    }
+    if (pointer[0] != '/')
+    {
+        throw std::runtime_error(("JSON pointer must start with '/'"));
+    }
+    size_t i = 1;
+    for (;;)
+    {
+        std::string key;
+        size_t index = 0;
+        bool digits = true;
+        for (; i < pointer.size() && pointer[i] != '/'; i++)
+        {
+            char c = pointer[i];
+            if (c == '~')
+            {
+                char e = i + 1 < pointer.size() ? pointer[i + 1] : '\0';
+                if (e != '0' && e != '1')
+                {
+                    throw std::runtime_error(("Invalid escape in JSON pointer at ") + std::to_string(i));
+                }
+                c = e == '0' ? '~' : '/';
+                i++;
+                digits = false;
+            }
+            else if (c < '0' || c > '9' || key.size() >= 18)
+            {
+                digits = false;
+            }
+            else
+            {
+                index = index * 10 + (c - '0');
+            }
+            key += c;
+        }
+        //"0" or digits without a leading zero, "-" and the rest are keys only
+        if (key.empty() || (key[0] == '0' && key.size() > 1))
+        {
+            digits = false;
+        }
+        _tokens.push_back({ json::object::key_type(std::move(key)), digits ? index : no_index });
+        if (i == pointer.size())
+        {
+            break;
+        }
+        i++; //the '/'
+    }
+}
+
+const json* jpointer::step(const json* v, const token& t)
+{
+    if (v->is_object())
+    {
+        auto& obj = v->as_object();
+        auto it = obj.find(t.key);
+        return it != obj.end() ? &it->second : nullptr;
+    }
+    if (v->is_array() && t.index != no_index)
+    {
+        auto& arr = v->as_array();
+        return t.index < arr.size() ? &arr[t.index] : nullptr;
+    }
+    return nullptr;
+}
+
+const json* jpointer::resolve(const json& doc) const
+{
+    const json* v = &doc;
+    for (size_t i = 0; i < _tokens.size() && v != nullptr; i++)
+    {
+        v = step(v, _tokens[i]);
+    }
+    return v;
+}
+
+const json& jpointer::get(const json& doc) const
+{
+    const json* v = resolve(doc);
+    return v != nullptr ? *v : json::null;
+}
+
+jpointer::set::set(const std::vector<jpointer>& pointers)
+{
+    for (auto& p : pointers)
+    {
+        add(p);
+    }
+}
+
+size_t jpointer::set::add(const jpointer& pointer)
+{
+    if (_nodes.empty())
+    {
+        _nodes.push_back({ { json::object::key_type(), no_index }, {}, {} });
+    }
+    size_t n = 0;
+    for (auto& t : pointer._tokens)
+    {
+        size_t next = 0;
+        for (size_t c : _nodes[n].children)
+        {
+            if (_nodes[c].t.key == t.key)
+            {
+                next = c;
+                break;
+            }
+        }
+        if (next == 0)
+        {
+            next = _nodes.size();
+            _nodes.push_back({ t, {}, {} });
+            _nodes[n].children.push_back(next);
+        }
+        n = next;
+    }
+    _nodes[n].pointers.push_back(_count);
+    return _count++;
+}
+
+void jpointer::set::resolve(const json& doc, std::vector<const json*>& out) const
+{
+    out.assign(_count, nullptr);
+    if (_nodes.empty())
+    {
+        return;
+    }
+    std::vector<std::pair<size_t, const json*>> stack;
+    stack.emplace_back(0, &doc);
+    while (!stack.empty())
+    {
+        auto [n, v] = stack.back();
+        stack.pop_back();
+        for (size_t i : _nodes[n].pointers)
+        {
+            out[i] = v;
+        }
+        for (size_t c : _nodes[n].children)
+        {
+            const json* child = step(v, _nodes[c].t);
+            if (child != nullptr)
+            {
+                stack.emplace_back(c, child);
+            }
+        }
+    }
+}
+
+}
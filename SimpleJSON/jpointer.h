@@ -0,0 +1,81 @@
+#pragma once
+
+#include "json.h"
+#include <string>
+#include <string_view>
+#include <vector>
+namespace mq
+{
+
+/*
+ * A JSON Pointer (RFC 6901) such as "/user/address/zip", split and
+ * unescaped once so that it can be resolved against many documents.
+ * Each reference token keeps both readings, the object key and, when it
+ * is a valid array index, the index, so resolving does not parse it.
+ */
+class jpointer
+{
+public:
+    class set;
+
+    //throws a std::runtime_error when `pointer` is neither empty nor starts with '/', or has a bad '~' escape
+    explicit jpointer(std::string_view pointer);
+
+    //the value `doc` has at this pointer, nullptr when there is none
+    const json* resolve(const json& doc) const;
+    //the value `doc` has at this pointer, `json::null` when there is none
+    const json& get(const json& doc) const;
+
+    const std::string& str() const
+    {
+        return _text;
+    }
+    size_t size() const
+    {
+        return _tokens.size();
+    }
+private:
+    static const size_t no_index = static_cast<size_t>(-1);
+    struct token
+    {
+        json::object::key_type key;
+        size_t index; //`no_index` when the token can not index an array
+    };
+    static const json* step(const json* v, const token& t);
+
+    std::string _text;
+    std::vector<token> _tokens;
+};
+
+/*
+ * Several pointers resolved together in one walk over a document. The
+ * pointers are merged in a tree by their common prefixes, so "/a/b/c"
+ * and "/a/b/d" look "a" and "b" up once.
+ */
+class jpointer::set
+{
+public:
+    set() = default;
+    explicit set(const std::vector<jpointer>& pointers);
+
+    //returns the index of the pointer, the one of its result in `resolve`
+    size_t add(const jpointer& pointer);
+    size_t size() const
+    {
+        return _count;
+    }
+
+    //`out[i]` is the value at the i-th pointer added, nullptr when there is none
+    void resolve(const json& doc, std::vector<const json*>& out) const;
+private:
+    struct node
+    {
+        token t;
+        std::vector<size_t> children;
+        std::vector<size_t> pointers; //the pointers ending here
+    };
+    std::vector<node> _nodes; //`_nodes[0]` is the root, its token is unused
+    size_t _count = 0;
+};
+
+}
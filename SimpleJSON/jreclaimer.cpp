@@ -0,0 +1,75 @@
+#include "jreclaimer.h"
+#include "jvalue.h"
+namespace mq
+{
+
+std::atomic<size_t> jreclaimer::threshold{ 0 };
+std::atomic<bool> jreclaimer::started{ false };
+thread_local bool jreclaimer::on_reclaimer_thread = false;
+
+/*
+ * Never destroyed: values released by the destructors of other statics
+ * may still come here during exit. What is left in the queue then is
+ * reclaimed by the operating system.
+ */
+jreclaimer& jreclaimer::instance()
+{
+    static jreclaimer* reclaimer = new jreclaimer;
+    return *reclaimer;
+}
+
+jreclaimer::jreclaimer()
+    : _queued(0)
+    , _pending_bytes(0)
+    , _reclaimed(0)
+{
+    _thread = std::thread([this] { run(); });
+    started.store(true, std::memory_order_release);
+}
+
+void jreclaimer::push(const jvalue* v, size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _queue.push_back(v);
+        _queued.fetch_add(1, std::memory_order_relaxed);
+        _pending_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    _wakeup.notify_one();
+}
+
+json::reclaim_status jreclaimer::status() const
+{
+    //a value no longer queued is already counted as reclaimed
+    return{ _queued.load(std::memory_order_acquire), _pending_bytes.load(std::memory_order_relaxed),
+            _reclaimed.load(std::memory_order_relaxed) };
+}
+
+/*
+ * The whole queue is taken at once, so pushing threads only wait for
+ * the swap, never for a value to be destroyed.
+ */
+void jreclaimer::run()
+{
+    on_reclaimer_thread = true;
+    std::vector<const jvalue*> batch;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _wakeup.wait(guard, [this] { return !_queue.empty(); });
+            batch.swap(_queue);
+        }
+        for (const jvalue* v : batch)
+        {
+            size_t bytes = jvalue::footprint(v);
+            json_flat_deleter::destroy(v);
+            _pending_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+            _reclaimed.fetch_add(1, std::memory_order_relaxed);
+            _queued.fetch_sub(1, std::memory_order_release);
+        }
+        batch.clear();
+    }
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "json.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+namespace mq
+{
+
+/*
+ * The thread behind `json::reclaim_in_background`. Released values that
+ * hold at least `threshold` bytes directly are queued by
+ * `json_flat_deleter` and destroyed here in batches.
+ */
+class jreclaimer
+{
+public:
+    static std::atomic<size_t> threshold; //0 when values are destroyed by the releasing thread
+    static std::atomic<bool> started; //whether `instance` was ever called
+    static thread_local bool on_reclaimer_thread; //its own values are not queued again
+    static jreclaimer& instance();
+
+    void push(const jvalue* v, size_t bytes);
+    json::reclaim_status status() const;
+private:
+    jreclaimer();
+    void run();
+
+    std::mutex _lock;
+    std::condition_variable _wakeup;
+    std::vector<const jvalue*> _queue;
+    std::atomic<size_t> _queued;
+    std::atomic<size_t> _pending_bytes;
+    std::atomic<size_t> _reclaimed;
+    std::thread _thread;
+};
+
+}
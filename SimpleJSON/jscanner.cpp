@@ -0,0 +1,395 @@
+#include "jscanner.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MQ_JSON_SSE2 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MQ_JSON_TARGET_AVX2
+#else
+#define MQ_JSON_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace mq
+{
+
+namespace
+{
+enum char_class : uint8_t
+{
+    WS = 1, OP = 2, QUOTE = 4, BACKSLASH = 8
+};
+
+struct class_table
+{
+    uint8_t v[256];
+    constexpr class_table() : v()
+    {
+        v[' '] = v['\t'] = v['\n'] = v['\r'] = WS;
+        v['{'] = v['}'] = v['['] = v[']'] = v[':'] = v[','] = OP;
+        v['\"'] = QUOTE;
+        v['\\'] = BACKSLASH;
+    }
+};
+constexpr class_table char_classes;
+
+inline int trailing_zeros(uint64_t v)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return static_cast<int>(i);
+#elif defined(_MSC_VER)
+    unsigned long i;
+    if (_BitScanForward(&i, static_cast<unsigned long>(v)))
+    {
+        return static_cast<int>(i);
+    }
+    _BitScanForward(&i, static_cast<unsigned long>(v >> 32));
+    return static_cast<int>(i) + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+/*
+ * Bit i of the result is set when byte i is escaped by a backslash.
+ * Backslashes are rare, so they are simply visited one by one.
+ */
+inline uint64_t find_escaped(uint64_t backslash, uint64_t& prev_escaped)
+{
+    uint64_t escaped = prev_escaped;
+    prev_escaped = 0;
+    backslash &= ~escaped;
+    while (backslash != 0)
+    {
+        int i = trailing_zeros(backslash);
+        if (i == 63)
+        {
+            prev_escaped = 1; //escapes the first byte of the next block
+            break;
+        }
+        escaped |= uint64_t(2) << i;
+        backslash &= ~(uint64_t(3) << i); //an escaped backslash escapes nothing
+    }
+    return escaped;
+}
+
+//bit i of the result is the xor of bits 0..i of `v`
+inline uint64_t prefix_xor(uint64_t v)
+{
+    v ^= v << 1;
+    v ^= v << 2;
+    v ^= v << 4;
+    v ^= v << 8;
+    v ^= v << 16;
+    v ^= v << 32;
+    return v;
+}
+
+bool cpu_has_avx2()
+{
+#if !defined(MQ_JSON_SSE2)
+    return false;
+#elif defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(r, 1);
+    if ((r[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) //OS saves the ymm registers
+    {
+        return false;
+    }
+    __cpuidex(r, 7, 0);
+    return (r[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/*
+ * Calls `f(base, ops, tokens)` for each 64-byte block, `ops` having a bit
+ * for each structural character outside strings and `tokens` one for each
+ * token start, see `jscanner::index`. Stops early when `f` returns false.
+ */
+template<class F>
+void scan_blocks(const char* s, size_t len, jscanner::block (*classify_block)(const char*), F f)
+{
+    uint64_t prev_escaped = 0; //1 when the first byte of the block is escaped
+    uint64_t prev_in_string = 0; //all ones when the previous block ended inside a string
+    uint64_t prev_scalar = 0; //1 when the previous block ended inside a number or literal
+    char tail[64];
+    for (size_t base = 0; base < len; base += 64)
+    {
+        const char* chunk = s + base;
+        if (len - base < 64) //never read past the end, pad the last block with spaces
+        {
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, chunk, len - base);
+            chunk = tail;
+        }
+        jscanner::block b = classify_block(chunk);
+        uint64_t escaped = find_escaped(b.backslash, prev_escaped);
+        uint64_t quote = b.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quote) ^ prev_in_string; //includes the opening quote
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+        uint64_t scalar = ~(b.ws | b.op | b.quote | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+
+        uint64_t ops = b.op & ~in_string;
+        if (!f(base, ops, ops | (quote & in_string) | scalar_start))
+        {
+            return;
+        }
+    }
+}
+}
+
+void jscanner::index(const char* s, size_t len, std::vector<uint32_t>& out)
+{
+    index(s, len, out, best_isa());
+}
+
+void jscanner::index(const char* s, size_t len, std::vector<uint32_t>& out, isa use)
+{
+    scan_blocks(s, len, classifier(use), [&out](size_t base, uint64_t, uint64_t tokens)
+    {
+        while (tokens != 0)
+        {
+            out.push_back(static_cast<uint32_t>(base + trailing_zeros(tokens)));
+            tokens &= tokens - 1;
+        }
+        return true;
+    });
+    out.push_back(static_cast<uint32_t>(len));
+}
+
+/*
+ * Only the brackets and commas outside strings are looked at, the depth
+ * is counted from the opening bracket at `s[0]`.
+ */
+bool jscanner::split(const char* s, size_t len, size_t parts, std::vector<size_t>& commas, size_t& close)
+{
+    size_t depth = 0;
+    size_t next_cut = len / parts; //a comma at or after it is taken
+    bool closed = false;
+    scan_blocks(s, len, classifier(best_isa()), [&](size_t base, uint64_t ops, uint64_t)
+    {
+        while (ops != 0)
+        {
+            size_t i = base + trailing_zeros(ops);
+            ops &= ops - 1;
+            switch (s[i])
+            {
+            case '{': case '[':
+                ++depth;
+                break;
+            case '}': case ']':
+                if (--depth == 0)
+                {
+                    close = i;
+                    closed = true;
+                    return false;
+                }
+                break;
+            case ',':
+                if (depth == 1 && i >= next_cut && commas.size() + 1 < parts)
+                {
+                    commas.push_back(i);
+                    next_cut = len / parts * (commas.size() + 1);
+                }
+                break;
+            default:;
+            }
+        }
+        return true;
+    });
+    return closed;
+}
+
+jscanner::block (*jscanner::classifier(isa use))(const char*)
+{
+    return use == isa::avx2 ? classify_avx2
+         : use == isa::sse2 ? classify_sse2
+         : classify_scalar;
+}
+
+jscanner::block jscanner::classify(const char* s, isa use)
+{
+    switch (use)
+    {
+    case isa::avx2:
+        return classify_avx2(s);
+    case isa::sse2:
+        return classify_sse2(s);
+    default:
+        return classify_scalar(s);
+    }
+}
+
+jscanner::isa jscanner::best_isa()
+{
+    static const isa best = supported(isa::avx2) ? isa::avx2
+                          : supported(isa::sse2) ? isa::sse2
+                          : isa::scalar;
+    return best;
+}
+
+bool jscanner::supported(isa use)
+{
+    switch (use)
+    {
+    case isa::avx2:
+        return cpu_has_avx2();
+    case isa::sse2:
+#ifdef MQ_JSON_SSE2
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return true;
+    }
+}
+
+jscanner::block jscanner::classify_scalar(const char* s)
+{
+    block b{0, 0, 0, 0};
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t c = char_classes.v[static_cast<unsigned char>(s[i])];
+        b.ws |= (c & 1) << i;
+        b.op |= ((c >> 1) & 1) << i;
+        b.quote |= ((c >> 2) & 1) << i;
+        b.backslash |= ((c >> 3) & 1) << i;
+    }
+    return b;
+}
+
+#ifdef MQ_JSON_SSE2
+jscanner::block jscanner::classify_sse2(const char* s)
+{
+    block b{0, 0, 0, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16 * i));
+        auto eq = [v](char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+        auto bits = [](__m128i m) { return static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m))); };
+        __m128i ws = _mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), _mm_or_si128(eq('\n'), eq('\r')));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_or_si128(eq('{'), eq('}')), _mm_or_si128(eq('['), eq(']'))),
+                                  _mm_or_si128(eq(':'), eq(',')));
+        b.ws |= bits(ws) << (16 * i);
+        b.op |= bits(op) << (16 * i);
+        b.quote |= bits(eq('\"')) << (16 * i);
+        b.backslash |= bits(eq('\\')) << (16 * i);
+    }
+    return b;
+}
+
+MQ_JSON_TARGET_AVX2 jscanner::block jscanner::classify_avx2(const char* s)
+{
+    block b{0, 0, 0, 0};
+    for (int i = 0; i < 2; i++)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32 * i));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(']')))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"'));
+        __m256i backslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+        b.ws |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << (32 * i);
+        b.op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << (32 * i);
+        b.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(quote))) << (32 * i);
+        b.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(backslash))) << (32 * i);
+    }
+    return b;
+}
+#else
+jscanner::block jscanner::classify_sse2(const char* s)
+{
+    return classify_scalar(s);
+}
+
+jscanner::block jscanner::classify_avx2(const char* s)
+{
+    return classify_scalar(s);
+}
+#endif
+
+/*
+ * Strings are mostly short, SSE2 is used as it needs no dispatch and
+ * every x64 CPU has it.
+ */
+const char* jscanner::find_quote_or_backslash(const char* s, const char* e)
+{
+#ifdef MQ_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; e - s >= 16; s += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+        if (mask != 0)
+        {
+            return s + trailing_zeros(static_cast<uint32_t>(mask));
+        }
+    }
+#endif
+    for (; s != e && *s != '\"' && *s != '\\'; ++s);
+    return s;
+}
+
+const char* jscanner::find_non_space(const char* s, const char* e)
+{
+#ifdef MQ_JSON_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; e - s >= 16; s += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, cr)));
+        int mask = ~_mm_movemask_epi8(ws) & 0xffff;
+        if (mask != 0)
+        {
+            return s + trailing_zeros(static_cast<uint32_t>(mask));
+        }
+    }
+#endif
+    for (; s != e && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r'); ++s);
+    return s;
+}
+
+const char* jscanner::find_non_ascii(const char* s, const char* e)
+{
+#ifdef MQ_JSON_SSE2
+    for (; e - s >= 16; s += 16)
+    {
+        //the high bit of each byte
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+        if (mask != 0)
+        {
+            return s + trailing_zeros(static_cast<uint32_t>(mask));
+        }
+    }
+#endif
+    for (; s != e && static_cast<unsigned char>(*s) < 0x80; ++s);
+    return s;
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+namespace mq
+{
+
+/*
+ * The first stage of parsing: classify the input 64 bytes at a time with
+ * SIMD instructions and record where every token starts, so the parser
+ * can jump over whitespace instead of walking it byte by byte.
+ */
+class jscanner
+{
+public:
+    enum class isa
+    {
+        scalar, sse2, avx2
+    };
+
+    struct block //one bit per input byte
+    {
+        uint64_t ws;
+        uint64_t op; // { } [ ] : ,
+        uint64_t quote;
+        uint64_t backslash;
+    };
+
+    /*
+     * Append the offset of every structural character, every opening quote
+     * and the first byte of every number or literal to `out`, followed by
+     * `len` itself as a sentinel. Characters inside strings are skipped.
+     */
+    static void index(const char* s, size_t len, std::vector<uint32_t>& out);
+    static void index(const char* s, size_t len, std::vector<uint32_t>& out, isa use);
+
+    /*
+     * `s[0]` opens an array or an object. Append to `commas` at most
+     * `parts - 1` of its top level commas, close to splitting it in `parts`
+     * ranges of equal size, and set `close` to its closing bracket. Returns
+     * false when it is not closed. Nothing else is checked.
+     */
+    static bool split(const char* s, size_t len, size_t parts, std::vector<size_t>& commas, size_t& close);
+
+    //the first `"` or `\` from `s` on, `e` when there is none
+    static const char* find_quote_or_backslash(const char* s, const char* e);
+    //the first byte that is not a JSON space from `s` on, `e` when there is none
+    static const char* find_non_space(const char* s, const char* e);
+    //the first byte above 0x7f from `s` on, `e` when there is none
+    static const char* find_non_ascii(const char* s, const char* e);
+
+    static block classify(const char* s, isa use); //reads exactly 64 bytes
+    static isa best_isa();
+    static bool supported(isa use);
+private:
+    static block (*classifier(isa use))(const char*);
+    static block classify_scalar(const char* s);
+    static block classify_sse2(const char* s);
+    static block classify_avx2(const char* s);
+};
+
+}
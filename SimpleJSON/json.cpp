@@ -1,306 +1,183 @@
 #include "json.h"
-#include <cassert>
+#include "jvalue.h"
 #include "jparser.h"
+#include "jwriter.h"
+#include "jreclaimer.h"
+#include <charconv>
+#include <cmath>
 
 namespace mq
 {
 
-class jvalue
-{
-    friend json;
-public:
-    virtual ~jvalue() = default;
-
-    jvalue() = default;
-    jvalue(const jvalue&) = delete;
-    jvalue& operator=(const jvalue&) = delete;
-    jvalue(jvalue&&) = delete;
-    jvalue& operator=(jvalue&&) = delete;
-
-    virtual json::type type() const = 0;
-    const json& get_value_unsafe(const std::string& key) const;
-    const json& get_value_unsafe(size_t i) const;
-    bool get_bool_unsafe() const;
-    int64_t get_int_unsafe() const;
-    const std::string& get_string_unsafe() const;
-    const json::object& get_object_unsafe() const;
-    const json::array& get_array_unsafe() const;
-    double get_double_unsafe() const;
-
-    virtual jvalue* clone() = 0;
-    virtual bool equals_to_unsafe(const jvalue* r) const = 0;
-
-    static jvalue* null_instance();
-    static jvalue* true_instance();
-    static jvalue* false_instance();
-    static jvalue* int_instance(int64_t i);
-    static jvalue* double_instance(double d);
-    static jvalue* string_instance(const std::string& s);
-    static jvalue* string_instance(std::string&& s);
-    static jvalue* object_instance(const json::object& s);
-    static jvalue* object_instance(json::object&& s);
-    static jvalue* array_instance(const json::array& s);
-    static jvalue* array_instance(json::array&& s);
-};
-
-class jnumber : public jvalue
-{
-public:
-    friend class json;
-    friend class jvalue;
-    json::type type() const override
-    {
-        return json::NUMBER;
-    }
-    virtual int64_t get_int() const = 0;
-    virtual double get_double() const = 0;
-    virtual bool equals_to(int64_t i) const = 0; //used for double dispatch
-    virtual bool equals_to(double i) const = 0;
-};
-
-class jint : public jnumber
+/*
+ * A value big enough is handed to the reclaimer thread when it is
+ * enabled, see `json::reclaim_in_background`. The children of a node
+ * being destroyed are checked too, so a big array under a small object
+ * does not stay on this thread.
+ */
+void json_flat_deleter::operator()(const jvalue* v) const noexcept
 {
-public:
-    friend class json;
-    friend class jvalue;
-    jint(int64_t i) : _v(i) {}
-
-    jvalue* clone() override
-    {
-        return new jint(_v);
-    }
-    int64_t get_int() const override
-    {
-        return _v;
-    }
-    double get_double() const override
-    {
-        return static_cast<double>(_v);
-    }
-    bool equals_to_unsafe(const jvalue* r) const override //use double dispatch to compare two number
+    if (v == nullptr)
     {
-        assert(reinterpret_cast<const jnumber*>(r) != nullptr);
-        auto num = static_cast<const jnumber*>(r);
-        return num->equals_to(_v);
+        return;
     }
-protected:
-    bool equals_to(int64_t i) const override
+    size_t threshold = jreclaimer::threshold.load(std::memory_order_relaxed);
+    if (threshold != 0 && !jreclaimer::on_reclaimer_thread)
     {
-        return _v == i;
+        size_t bytes = jvalue::footprint(v);
+        if (bytes >= threshold)
+        {
+            jreclaimer::instance().push(v, bytes);
+            return;
+        }
     }
-    bool equals_to(double i) const override
+    if (deferred_pool != nullptr)
     {
-        return static_cast<double>(_v) == i;
+#ifdef _DEBUG
+        if (std::find(deferred_pool->begin(), deferred_pool->end(), v) != deferred_pool->end())
+        {
+            assert(0);
+        }
+#endif
+        deferred_pool->push_back(v); //a child of a node being destroyed by `destroy`
+        return;
     }
-private:
-    int64_t _v;
-};
+    destroy(v);
+}
 
-class jdouble : public jnumber
+/*
+ * The children of a node being destroyed come back to `operator()` and
+ * are only queued, they are destroyed one by one here. The pool lives on
+ * this stack frame, the thread local pointer to it needs no cleanup at
+ * thread exit.
+ */
+void json_flat_deleter::destroy(const jvalue* v) noexcept
 {
-public:
-    friend class json;
-    friend class jvalue;
-    jdouble(double i) : _v(i) {}
-
-    jvalue* clone() override
+    std::vector<const jvalue*> pool;
+    deferred_pool = &pool;
+    jvalue::destroy(v);
+    while (!pool.empty())
     {
-        return new jdouble(_v);
+        const jvalue* next = pool.back();
+        pool.pop_back();
+        jvalue::destroy(next);
     }
-    int64_t get_int() const override
-    {
-        return static_cast<int64_t>(_v);
-    }
-    double get_double() const override
-    {
-        return _v;
-    }
-    bool equals_to_unsafe(const jvalue* r) const override //use double dispatch to compare two number
-    {
-        assert(reinterpret_cast<const jnumber*>(r) != nullptr);
-        auto num = static_cast<const jnumber*>(r);
-        return num->equals_to(_v);
-    }
-protected:
-    bool equals_to(int64_t i) const override
-    {
-        return _v == static_cast<double>(i);
-    }
-    bool equals_to(double i) const override
-    {
-        return _v == i;
-    }
-private:
-    double _v;
-};
+    deferred_pool = nullptr;
+}
 
-class jboolean : public jvalue
-{
-public:
-    friend class json;
-    friend class jvalue;
-    jboolean(bool b) : _v(b) {}
+thread_local std::vector<const jvalue*>* json_flat_deleter::deferred_pool;
 
-    json::type type() const override
-    {
-        return json::BOOLEAN;
-    }
-    jvalue* clone() override
-    {
-        return _v ? true_instance() : false_instance();
-    }
-    bool equals_to_unsafe(const jvalue* r) const override
-    {
-        assert(reinterpret_cast<decltype(this)>(r) != nullptr);
-        return _v == static_cast<decltype(this)>(r)->_v;
-    }
-private:
-    bool _v;
-};
+static_assert(sizeof(json) <= 16, "json should stay as small as a pointer and a tag");
 
-class jstring : public jvalue
+json::json(jvalue* v)
+    : _borrowed(false)
 {
-public:
-    friend class json;
-    friend class jvalue;
-    jstring(const std::string& s) : _v(s) {}
-    jstring(std::string&& s) : _v(std::move(s)) {}
-
-    json::type type() const override
-    {
-        return json::STRING;
-    }
-    jvalue* clone() override
-    {
-        return new jstring(_v);
-    }
-    bool equals_to_unsafe(const jvalue* r) const override
+    _v.node = v;
+    switch (v->type())
     {
-        assert(reinterpret_cast<decltype(this)>(r) != nullptr);
-        return _v == static_cast<decltype(this)>(r)->_v;
+    case STRING:
+        _tag = tag::string;
+        break;
+    case NUMBER:
+        _tag = tag::number_text;
+        break;
+    case OBJECT:
+        _tag = tag::object;
+        break;
+    case ARRAY:
+        _tag = tag::array;
+        break;
+    default:
+        assert(0);
     }
-private:
-    std::string _v;
-};
+}
 
-class jobject : public jvalue
+/*
+ * Make a handle that does not own `v`, used for values living in the
+ * arena of a `json::document`.
+ */
+json json::borrow(jvalue* v)
 {
-public:
-    friend class json;
-    friend class jvalue;
-    jobject(const json::object& s) : _v(s) {}
-    jobject(json::object&& s) : _v(std::move(s)) {}
-    json::type type() const override
-    {
-        return json::OBJECT;
-    }
-    jvalue* clone() override
-    {
-        return new jobject(_v);
-    }
-    bool equals_to_unsafe(const jvalue* r) const override
-    {
-        assert(reinterpret_cast<decltype(this)>(r) != nullptr);
-        return _v == static_cast<decltype(this)>(r)->_v;
-    }
-private:
-    json::object _v;
-};
+    json r(v);
+    r._borrowed = true;
+    return r;
+}
 
-class jarray : public jvalue
+jvalue* json::get() const
 {
-public:
-    friend class json;
-    friend class jvalue;
-    jarray(const json::array& s) : _v(s) {}
-    jarray(json::array&& s) : _v(std::move(s)) {}
+    assert(has_node());
+    return _v.node;
+}
 
-    json::type type() const override
-    {
-        return json::ARRAY;
-    }
-    jvalue* clone() override
-    {
-        return new jarray(_v);
-    }
-    bool equals_to_unsafe(const jvalue* r) const override
-    {
-        assert(reinterpret_cast<decltype(this)>(r) != nullptr);
-        return _v == static_cast<decltype(this)>(r)->_v;
-    }
-private:
-    json::array _v;
-};
+bool json::has_node() const
+{
+    return _tag >= tag::string;
+}
 
-class jnull : public jvalue
+/*
+ * Copy on write: give this handle its own node before it is modified.
+ */
+void json::detach()
 {
-public:
-    json::type type() const override
-    {
-        return json::NUL;
-    }
-    jvalue* clone() override
-    {
-        return this;
-    }
-    bool equals_to_unsafe(const jvalue* r) const override
+    if (_borrowed || _v.node->_refs.load(std::memory_order_acquire) != 1)
     {
-        return this == r; //there should only 1 null instance
+        *this = json(get()->clone());
     }
-};
+}
 
-void json_flat_deleter::operator()(const jvalue* v) const noexcept
+void json::release() noexcept
 {
-#ifdef _DEBUG
-    if (std::find(deferred_pool.begin(), deferred_pool.end(), v) != deferred_pool.end())
+    if (has_node() && !_borrowed && _v.node->_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
     {
-        assert(0);
-    }
-#endif
-    if (v == nullptr)
-    {
-        return;
-    }
-    switch (v->type())
-    {
-    case json::OBJECT:
-    case json::ARRAY:
-    case json::STRING:
-    case json::NUMBER:
-        deferred_pool.push_back(v);
-        start_delete(); // No defer at now
-    default:;
+        json_flat_deleter{}(_v.node);
     }
 }
 
-void json_flat_deleter::start_delete()
+json::json(const json& r)
+    : _v(r._v)
+    , _tag(r._tag)
+    , _borrowed(r._borrowed)
 {
-    if (is_started)
+    if (has_node() && !_borrowed)
     {
-        return;
-    }
-    is_started = true;
-    size_t i = 0;
-    while (i != deferred_pool.size())
-    {
-        delete deferred_pool[i];
-        i++;
+        _v.node->_refs.fetch_add(1, std::memory_order_relaxed);
     }
-    deferred_pool.clear();
-    is_started = false;
 }
 
-bool json_flat_deleter::is_started;
-std::vector<const jvalue*> json_flat_deleter::deferred_pool;
+json& json::operator=(const json& r)
+{
+    json t(r);
+    return *this = std::move(t);
+}
 
-json::json(jvalue* v)
-    : _node(v, json_flat_deleter{})
+json::json(json&& r) noexcept
+    : _v(r._v)
+    , _tag(r._tag)
+    , _borrowed(r._borrowed)
 {
+    r._tag = tag::null;
 }
 
-jvalue* json::get() const
+/*
+ * `r` may live inside the value being replaced (`j = std::move(j[0])`),
+ * so take it over before releasing the old value.
+ */
+json& json::operator=(json&& r) noexcept
 {
-    return _node.get();
+    payload v = r._v;
+    tag t = r._tag;
+    bool borrowed = r._borrowed;
+    r._tag = tag::null;
+    release();
+    _v = v;
+    _tag = t;
+    _borrowed = borrowed;
+    return *this;
+}
+
+json::~json()
+{
+    release();
 }
 
 json::json()
@@ -309,23 +186,29 @@ json::json()
 }
 
 json::json(std::nullptr_t)
-    : json(jvalue::null_instance())
+    : _tag(tag::null)
+    , _borrowed(false)
 {
+    _v.node = nullptr;
 }
 
 json::json(int d)
-    : json(jvalue::int_instance(d))
+    : json(static_cast<int64_t>(d))
 {
 }
 
 json::json(int64_t d)
-    : json(jvalue::int_instance(d))
+    : _tag(tag::integer)
+    , _borrowed(false)
 {
+    _v.i = d;
 }
 
 json::json(double d)
-    : json(jvalue::double_instance(d))
+    : _tag(tag::fraction)
+    , _borrowed(false)
 {
+    _v.d = d;
 }
 
 json::json(const std::string& s)
@@ -364,41 +247,93 @@ json::json(array&& r)
 }
 
 json::json(bool b)
-    : json(b ? jvalue::true_instance() : jvalue::false_instance())
+    : _tag(tag::boolean)
+    , _borrowed(false)
 {
+    _v.b = b;
 }
 
 bool json::as_bool() const
 {
-    if (value_type() != BOOLEAN)
+    if (_tag != tag::boolean)
     {
         return false;
     }
-    return get()->get_bool_unsafe();
+    return _v.b;
+}
+
+namespace
+{
+//the text of a number checked by the parser, converted when it is asked for
+double text_to_double(const std::string& text)
+{
+    double d = 0;
+    if (std::from_chars(text.data(), text.data() + text.size(), d).ec == std::errc::result_out_of_range)
+    {
+        //too far from 0 for a double, or too close to it
+        size_t exponent = text.find_first_of("eE");
+        bool tiny = exponent != std::string::npos && text[exponent + 1] == '-';
+        d = tiny ? 0.0 : HUGE_VAL;
+        return text[0] == '-' ? -d : d;
+    }
+    return d;
+}
+
+int64_t text_to_int(const std::string& text)
+{
+    int64_t i = 0;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), i);
+    if (res.ec == std::errc() && res.ptr == text.data() + text.size())
+    {
+        return i;
+    }
+    double d = text_to_double(text); //outside int64_t or not an integer, saturate
+    if (d >= 9223372036854775808.0)
+    {
+        return INT64_MAX;
+    }
+    if (d <= -9223372036854775808.0)
+    {
+        return INT64_MIN;
+    }
+    return static_cast<int64_t>(d);
+}
 }
 
 int64_t json::as_int() const
 {
-    if (value_type() != NUMBER)
+    switch (_tag)
     {
+    case tag::integer:
+        return _v.i;
+    case tag::fraction:
+        return static_cast<int64_t>(_v.d);
+    case tag::number_text:
+        return text_to_int(get()->get_string_unsafe());
+    default:
         return 0;
     }
-    return get()->get_int_unsafe();
 }
 
 double json::as_double() const
 {
-    if (value_type() != NUMBER)
+    switch (_tag)
     {
+    case tag::integer:
+        return static_cast<double>(_v.i);
+    case tag::fraction:
+        return _v.d;
+    case tag::number_text:
+        return text_to_double(get()->get_string_unsafe());
+    default:
         return 0;
     }
-    return get()->get_double_unsafe();
 }
 
 const std::string& json::as_string() const
 {
     static std::string empty;
-    if (value_type() != STRING)
+    if (_tag != tag::string)
     {
         return empty;
     }
@@ -408,7 +343,7 @@ const std::string& json::as_string() const
 const json::object& json::as_object() const
 {
     static object empty;
-    if (value_type() != OBJECT)
+    if (_tag != tag::object)
     {
         return empty;
     }
@@ -418,7 +353,7 @@ const json::object& json::as_object() const
 const json::array& json::as_array() const
 {
     static array empty;
-    if (value_type() != ARRAY)
+    if (_tag != tag::array)
     {
         return empty;
     }
@@ -427,76 +362,137 @@ const json::array& json::as_array() const
 
 json::type json::value_type() const
 {
-    return get()->type();
+    static const type types[] = {NUL, BOOLEAN, NUMBER, NUMBER, STRING, OBJECT, ARRAY, NUMBER};
+    return types[static_cast<int>(_tag)];
 }
 
 bool json::is_object() const
 {
-    return get()->type() == json::OBJECT;
+    return _tag == tag::object;
 }
 
 bool json::is_array() const
 {
-    return get()->type() == json::ARRAY;
+    return _tag == tag::array;
 }
 
 bool json::is_number() const
 {
-    return get()->type() == json::NUMBER;
+    return _tag == tag::integer || _tag == tag::fraction || _tag == tag::number_text;
 }
 
 bool json::is_string() const
 {
-    return get()->type() == json::STRING;
+    return _tag == tag::string;
 }
 
 bool json::is_boolean() const
 {
-    return get()->type() == json::BOOLEAN;
+    return _tag == tag::boolean;
 }
 
 bool json::is_null() const
 {
-    return get()->type() == json::NUL;
+    return _tag == tag::null;
 }
 
-const json& json::operator[](const std::string& i) const
+const json& json::operator[](std::string_view key) const
 {
-    if (value_type() == OBJECT)
-    {
-        return get()->get_value_unsafe(i);
-    }
-    return null;
+    const json* v = find(key);
+    return v != nullptr ? *v : null;
 }
 
-json& json::operator[](const std::string& i)
+json& json::operator[](std::string_view key)
 {
-    if (value_type() != OBJECT)
+    if (_tag != tag::object)
     {
         *this = object{};
     }
-    if (_node.use_count() != 1)
+    detach();
+    auto& obj = static_cast<jobject*>(get())->_v;
+#ifdef MQ_JSON_FLAT_OBJECT
+    return obj.try_emplace(key).first->second;
+#else
+    auto it = obj.lower_bound(key);
+    if (it == obj.end() || it->first != key)
     {
-        _node.reset(get()->clone(), json_flat_deleter{});
+        it = obj.emplace_hint(it, std::string(key), json{}); //the key is only built when it is new
     }
-    return static_cast<jobject*>(get())->_v[i];
+    return it->second;
+#endif
 }
 
-json json::parse(const std::string& s)
+const json* json::find(std::string_view key) const
+{
+    if (_tag == tag::object)
+    {
+        return get()->find_unsafe(key);
+    }
+    return nullptr;
+}
+
+json json::parse(std::string_view s)
 {
     return jparser::parse(s);
 }
 
-const json& jvalue::get_value_unsafe(const std::string& key) const
+json json::parse(const char* s, size_t len)
+{
+    return jparser::parse(s, len);
+}
+
+json json::parse_file(const std::string& path)
+{
+    std::string err;
+    return jparser::parse_file(path, err);
+}
+
+/*
+ * From now on a value released with at least `min_bytes` held directly,
+ * like an array of that many bytes of elements, is destroyed on a
+ * background thread instead of the releasing one. 0 turns it off again.
+ */
+void json::reclaim_in_background(size_t min_bytes)
+{
+    if (min_bytes != 0)
+    {
+        jreclaimer::instance(); //start the thread here rather than in a destructor
+    }
+    jreclaimer::threshold.store(min_bytes, std::memory_order_relaxed);
+}
+
+json::reclaim_status json::reclaim_stats()
+{
+    if (!jreclaimer::started.load(std::memory_order_acquire))
+    {
+        return{ 0, 0, 0 };
+    }
+    return jreclaimer::instance().status();
+}
+
+std::string json::dump(bool pretty) const
+{
+    std::string out;
+    out.reserve(256);
+    jwriter::write(*this, out, pretty);
+    return out;
+}
+
+void json::dump_to(std::string& out, bool pretty) const
+{
+    jwriter::write(*this, out, pretty);
+}
+
+const json* jvalue::find_unsafe(std::string_view key) const
 {
     assert(reinterpret_cast<const jobject*>(this) != nullptr);
     auto& obj = static_cast<const jobject*>(this)->_v;
     auto res = obj.find(key);
     if (res == obj.end())
     {
-        return json::null;
+        return nullptr;
     }
-    return res->second;
+    return &res->second;
 }
 
 const json& jvalue::get_value_unsafe(size_t i) const
@@ -510,18 +506,6 @@ const json& jvalue::get_value_unsafe(size_t i) const
     return json::null;
 }
 
-bool jvalue::get_bool_unsafe() const
-{
-    assert(reinterpret_cast<const jboolean*>(this) != nullptr);
-    return static_cast<const jboolean*>(this)->_v;
-}
-
-int64_t jvalue::get_int_unsafe() const
-{
-    assert(reinterpret_cast<const jnumber*>(this) != nullptr);
-    return static_cast<const jnumber*>(this)->get_int();
-}
-
 const std::string& jvalue::get_string_unsafe() const
 {
     assert(reinterpret_cast<const jstring*>(this) != nullptr);
@@ -540,38 +524,81 @@ const json::array& jvalue::get_array_unsafe() const
     return static_cast<const jarray*>(this)->_v;
 }
 
-double jvalue::get_double_unsafe() const
-{
-    assert(reinterpret_cast<const jnumber*>(this) != nullptr);
-    return static_cast<const jnumber*>(this)->get_double();
-}
-
-jvalue* jvalue::null_instance()
-{
-    static jnull instance;
-    return &instance;
-}
-
-jvalue* jvalue::true_instance()
+jvalue* jvalue::clone() const
 {
-    static jboolean instance{true};
-    return &instance;
+    switch (_type)
+    {
+    case json::STRING:
+    case json::NUMBER:
+        return new jstring(static_cast<const jstring*>(this)->_v, _type);
+    case json::OBJECT:
+        return new jobject(static_cast<const jobject*>(this)->_v);
+    case json::ARRAY:
+        return new jarray(static_cast<const jarray*>(this)->_v);
+    default:
+        assert(0);
+        return nullptr;
+    }
 }
 
-jvalue* jvalue::false_instance()
+bool jvalue::equals_to_unsafe(const jvalue* r) const
 {
-    static jboolean instance{false};
-    return &instance;
+    assert(_type == r->_type);
+    switch (_type)
+    {
+    case json::STRING:
+    case json::NUMBER: //the same text, other spellings of the number compare as doubles
+        return static_cast<const jstring*>(this)->_v == static_cast<const jstring*>(r)->_v;
+    case json::OBJECT:
+        return static_cast<const jobject*>(this)->_v == static_cast<const jobject*>(r)->_v;
+    case json::ARRAY:
+        return static_cast<const jarray*>(this)->_v == static_cast<const jarray*>(r)->_v;
+    default:
+        assert(0);
+        return false;
+    }
 }
 
-jvalue* jvalue::int_instance(int64_t i)
+void jvalue::destroy(const jvalue* v)
 {
-    return new jint(i);
+    switch (v->_type)
+    {
+    case json::STRING:
+    case json::NUMBER:
+        delete static_cast<const jstring*>(v);
+        break;
+    case json::OBJECT:
+        delete static_cast<const jobject*>(v);
+        break;
+    case json::ARRAY:
+        delete static_cast<const jarray*>(v);
+        break;
+    default:
+        assert(0);
+    }
 }
 
-jvalue* jvalue::double_instance(double d)
+//an estimate of the heap memory of the node itself
+size_t jvalue::footprint(const jvalue* v)
 {
-    return new jdouble(d);
+    switch (v->_type)
+    {
+    case json::STRING:
+    case json::NUMBER:
+        return sizeof(jstring) + static_cast<const jstring*>(v)->_v.capacity();
+    case json::OBJECT:
+#ifdef MQ_JSON_FLAT_OBJECT
+        return sizeof(jobject) + static_cast<const jobject*>(v)->_v.capacity() * sizeof(json::object::value_type);
+#else
+        //a tree node is the pair plus three pointers and a color
+        return sizeof(jobject) + static_cast<const jobject*>(v)->_v.size() * (sizeof(json::object::value_type) + 4 * sizeof(void*));
+#endif
+    case json::ARRAY:
+        return sizeof(jarray) + static_cast<const jarray*>(v)->_v.capacity() * sizeof(json);
+    default:
+        assert(0);
+        return 0;
+    }
 }
 
 jvalue* jvalue::string_instance(const std::string& s)
@@ -604,9 +631,34 @@ jvalue* jvalue::array_instance(json::array&& s)
     return new jarray(std::move(s));
 }
 
+jvalue* jvalue::string_instance(std::string&& s, jnode_arena& arena)
+{
+    return arena.create<jstring>(std::move(s));
+}
+
+jvalue* jvalue::number_instance(std::string_view text)
+{
+    return new jstring(std::string(text), json::NUMBER);
+}
+
+jvalue* jvalue::number_instance(std::string_view text, jnode_arena& arena)
+{
+    return arena.create<jstring>(std::string(text), json::NUMBER);
+}
+
+jvalue* jvalue::object_instance(json::object&& s, jnode_arena& arena)
+{
+    return arena.create<jobject>(std::move(s));
+}
+
+jvalue* jvalue::array_instance(json::array&& s, jnode_arena& arena)
+{
+    return arena.create<jarray>(std::move(s));
+}
+
 const json& json::operator[](size_t i) const
 {
-    if (value_type() == ARRAY)
+    if (_tag == tag::array)
     {
         return get()->get_value_unsafe(i);
     }
@@ -615,21 +667,14 @@ const json& json::operator[](size_t i) const
 
 json& json::operator[](size_t i)
 {
-    if (value_type() == ARRAY)
+    if (_tag == tag::array)
     {
+        detach(); //copy on write when shared
+        auto& arr = static_cast<jarray*>(get())->_v;
+        if (arr.size() <= i)
         {
-            auto& arr = static_cast<jarray*>(get())->_v;
-            if (arr.size() > i)
-            {
-                return arr[i];
-            }
-        }
-        if (_node.use_count() != 1) //copy on write when shared
-        {
-            _node.reset(get()->clone(), json_flat_deleter{});
+            arr.insert(arr.end(), i - arr.size() + 1, json{});
         }
-        auto& arr = static_cast<jarray*>(get())->_v; //array may change
-        arr.insert(arr.end(), i - arr.size() + 1, json{});
         return arr[i];
     }
     (*this) = array(i + 1);
@@ -638,7 +683,23 @@ json& json::operator[](size_t i)
 
 bool operator==(const json& l, const json& r)
 {
-    return l.get()->type() == r.get()->type() && l.get()->equals_to_unsafe(r.get());
+    if (l._tag != r._tag || (l._tag == json::tag::number_text && !l.get()->equals_to_unsafe(r.get())))
+    {
+        return l.is_number() && r.is_number() && l.as_double() == r.as_double();
+    }
+    switch (l._tag)
+    {
+    case json::tag::null:
+        return true;
+    case json::tag::boolean:
+        return l._v.b == r._v.b;
+    case json::tag::integer:
+        return l._v.i == r._v.i;
+    case json::tag::fraction:
+        return l._v.d == r._v.d;
+    default:
+        return l._v.node == r._v.node || l.get()->equals_to_unsafe(r.get());
+    }
 }
 
 bool operator!=(const json& l, const json& r)
@@ -648,6 +709,51 @@ bool operator!=(const json& l, const json& r)
 
 json json::null{};
 
+json::document::document()
+    : _arena(new jnode_arena)
+{
+}
+
+json::document::~document() = default;
+
+json::document::document(document&& r) noexcept = default;
+
+json::document& json::document::operator=(document&& r) noexcept = default;
+
+const json& json::document::root() const
+{
+    return _root;
+}
+
+void json::document::clear()
+{
+    _root = nullptr;
+    if (_arena)
+    {
+        _arena->clear();
+    }
+    else
+    {
+        _arena.reset(new jnode_arena); //moved from
+    }
+}
+
+json::document json::document::parse(std::string_view s)
+{
+    document doc;
+    std::string err;
+    jparser::parse(s, doc, err);
+    return doc;
+}
+
+json::document json::document::parse_file(const std::string& path)
+{
+    document doc;
+    std::string err;
+    jparser::parse_file(path, doc, err);
+    return doc;
+}
+
 
 
 }
@@ -16,35 +16,74 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <mutex>
 #include <memory>
 
+#ifdef MQ_JSON_FLAT_OBJECT
+#include "jflat_map.h"
+#endif
+
 namespace mq
 {
 
 class jvalue;
+class jnode_arena;
 
+/*
+ * Destroys a node and everything under it without recursion. Each thread
+ * has its own pool, so threads free their values in parallel with no lock.
+ */
 class json_flat_deleter
 {
+    friend class jreclaimer;
 public:
     void operator()(const jvalue* v) const noexcept;
-
-    static void start_delete();
 private:
-    static bool is_started;
-    static std::vector<const jvalue*> deferred_pool;
+    static void destroy(const jvalue* v) noexcept;
+
+    //the nodes the outermost call on this thread has still to destroy, null when there is no such call
+    static thread_local std::vector<const jvalue*>* deferred_pool;
 };
 
 class json
 {
+    friend class jvalue;
+    friend class jwriter;
+    friend class jparser;
 private:
-    using base = std::shared_ptr<jvalue>;
+    enum class tag : uint8_t
+    {
+        null, boolean, integer, fraction, string, object, array,
+        number_text //a number kept as its text in a node, see `jparser::numbers::keep_text`
+    };
     json(jvalue* v);
+    static json borrow(jvalue* v);
     jvalue* get() const;
-    std::shared_ptr<jvalue> _node;
+    bool has_node() const;
+    void detach();
+    void release() noexcept;
+
+    /*
+     * Scalars are kept inline, strings and containers live in a reference
+     * counted `jvalue` node. Checking the type is a compare on `_tag`.
+     */
+    union payload
+    {
+        bool b;
+        int64_t i;
+        double d;
+        jvalue* node;
+    } _v;
+    tag _tag;
+    bool _borrowed; //the node belongs to an arena, references are not counted
 public:
-    using object = std::map<std::string, json>;
+#ifdef MQ_JSON_FLAT_OBJECT
+    using object = jflat_map<json>; //members in insertion order with a hash index
+#else
+    using object = std::map<std::string, json, std::less<>>; //std::less<> finds keys by std::string_view
+#endif
     using array = std::vector<json>;
     static json null;
 
@@ -89,20 +128,69 @@ public:
     bool is_boolean() const;
     bool is_null() const;
 
-    json(const json& r) = default;
-    json& operator=(const json& r) = default;
-    json(json&& r) noexcept = default;
-    json& operator=(json&& r) noexcept = default;
+    json(const json& r);
+    json& operator=(const json& r);
+    json(json&& r) noexcept;
+    json& operator=(json&& r) noexcept;
+    ~json();
 
     const json& operator[](size_t i) const;
     json& operator[](size_t i);
-    const json& operator[](const std::string& i) const;
-    json& operator[](const std::string& i);
+    const json& operator[](std::string_view key) const;
+    json& operator[](std::string_view key);
+    //the member with `key`, nullptr when there is none or this is not an object
+    const json* find(std::string_view key) const;
 
     friend bool operator==(const json& l, const json& r);
     friend bool operator!=(const json& l, const json& r);
 
-    static json parse(const std::string& s);
+    std::string dump(bool pretty = false) const;
+    void dump_to(std::string& out, bool pretty = false) const;
+
+    static json parse(std::string_view s);
+    static json parse(const char* s, size_t len);
+    static json parse_file(const std::string& path);
+
+    struct reclaim_status
+    {
+        size_t queued; //values waiting for the reclaimer thread
+        size_t pending_bytes; //bytes they hold directly, the values under them are not counted
+        size_t reclaimed; //values the reclaimer thread has destroyed so far
+    };
+    static void reclaim_in_background(size_t min_bytes);
+    static reclaim_status reclaim_stats();
+
+    class document;
+};
+
+/*
+ * A parsed document whose value nodes live in one arena owned by the
+ * document, so parsing does not allocate every node separately. The
+ * characters of strings and the elements of arrays and objects are still
+ * allocated on the heap, and destroying the document runs each node's
+ * destructor, so it costs time in proportion to the number of values.
+ * The values returned by `root()`, and every copy of them, refer into
+ * the arena and must not outlive the document. Writing through a copy
+ * clones the changed container out of the arena as usual.
+ */
+class json::document
+{
+public:
+    document();
+    ~document();
+    document(document&& r) noexcept;
+    document& operator=(document&& r) noexcept;
+
+    const json& root() const;
+    //also makes a moved-from document usable again, parsing into it clears it first
+    void clear();
+
+    static document parse(std::string_view s);
+    static document parse_file(const std::string& path);
+private:
+    friend class jparser;
+    std::unique_ptr<jnode_arena> _arena;
+    json _root;
 };
 
 }
@@ -0,0 +1,406 @@
+#include "jstream_parser.h"
+#include "jparser.h"
+#include "jutf8.h"
+#include <cctype>
+#include <stdexcept>
+namespace mq
+{
+
+jstream_parser::jstream_parser()
+{
+    reset();
+}
+
+bool jstream_parser::feed(std::string_view data)
+{
+    return feed(data.data(), data.size());
+}
+
+/*
+ * Every state can be left at the end of a piece and resumed with the
+ * next one. Numbers and literals are only complete when the byte after
+ * them is seen, so the delimiter is looked at twice.
+ */
+bool jstream_parser::feed(const char* data, size_t len)
+{
+    if (_state == state::failed)
+    {
+        return false;
+    }
+    try
+    {
+        const char* p = data;
+        const char* e = data + len;
+        while (p != e)
+        {
+            char c = *p;
+            switch (_state)
+            {
+            case state::string:
+            {
+                if (_high_surrogate != 0 && c != '\\')
+                {
+                    throw std::runtime_error(("Expected low surrogate `\\uXXXX` at position ") + std::to_string(_offset));
+                }
+                const char* run = p;
+                while (p != e && *p != '\"' && *p != '\\')
+                {
+                    ++p;
+                }
+                _buf.append(run, p - run);
+                _offset += p - run;
+                if (p == e)
+                {
+                    continue;
+                }
+                if (*p == '\"')
+                {
+                    end_string();
+                }
+                else
+                {
+                    _state = state::escape;
+                }
+                break;
+            }
+            case state::escape:
+                if (_high_surrogate != 0 && c != 'u')
+                {
+                    throw std::runtime_error(("Expected low surrogate `\\uXXXX` at position ") + std::to_string(_offset));
+                }
+                _state = state::string;
+                switch (c)
+                {
+                case 'b':
+                    _buf.push_back('\b');
+                    break;
+                case 'f':
+                    _buf.push_back('\f');
+                    break;
+                case 'n':
+                    _buf.push_back('\n');
+                    break;
+                case 'r':
+                    _buf.push_back('\r');
+                    break;
+                case 't':
+                    _buf.push_back('\t');
+                    break;
+                case 'u':
+                    _tok.clear();
+                    _state = state::unicode;
+                    break;
+                default: // `"`, `\`, `/`
+                    _buf.push_back(c);
+                }
+                break;
+            case state::unicode:
+                _tok.push_back(c);
+                if (_tok.size() == 4)
+                {
+                    end_unicode();
+                }
+                break;
+            case state::number:
+                if (isdigit(c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+                {
+                    _tok.push_back(c);
+                    break;
+                }
+                end_number();
+                continue;
+            case state::literal:
+                if (c >= 'a' && c <= 'z')
+                {
+                    _tok.push_back(c);
+                    break;
+                }
+                end_literal();
+                continue;
+            case state::done:
+                p = e;
+                continue;
+            default: //between tokens
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+                {
+                    break;
+                }
+                switch (_state)
+                {
+                case state::value:
+                    begin_value(c);
+                    break;
+                case state::array_first:
+                    if (c == ']')
+                    {
+                        close(c);
+                        break;
+                    }
+                    begin_value(c);
+                    break;
+                case state::object_first:
+                    if (c == '}')
+                    {
+                        close(c);
+                        break;
+                    }
+                    [[fallthrough]];
+                case state::key:
+                    if (c != '\"')
+                    {
+                        throw std::runtime_error(("Expected string at position ") + std::to_string(_offset));
+                    }
+                    _buf.clear();
+                    _is_key = true;
+                    _state = state::string;
+                    break;
+                case state::colon:
+                    if (c != ':')
+                    {
+                        throw std::runtime_error(("Expected `:` at position ") + std::to_string(_offset));
+                    }
+                    _state = state::value;
+                    break;
+                default: //after_value
+                    if (c == ',')
+                    {
+                        _state = _nesting.back() == '[' ? state::value : state::key;
+                    }
+                    else if ((c == ']' && _nesting.back() == '[') || (c == '}' && _nesting.back() == '{'))
+                    {
+                        close(c);
+                    }
+                    else
+                    {
+                        throw std::runtime_error(("Expected `,` or closing bracket at position ") + std::to_string(_offset));
+                    }
+                }
+            }
+            ++p;
+            ++_offset;
+        }
+        return true;
+    }
+    catch (std::runtime_error& errorMsg)
+    {
+        _err = errorMsg.what();
+        _state = state::failed;
+        return false;
+    }
+}
+
+bool jstream_parser::finish()
+{
+    if (_state == state::failed)
+    {
+        return false;
+    }
+    try
+    {
+        if (_state == state::number)
+        {
+            end_number();
+        }
+        else if (_state == state::literal)
+        {
+            end_literal();
+        }
+        else if (_state == state::value && _nesting.empty()) //nothing but spaces, null like `jparser::parse`
+        {
+            end_value(json());
+        }
+        if (_state != state::done)
+        {
+            throw std::runtime_error(("Unexpected end of input"));
+        }
+        return true;
+    }
+    catch (std::runtime_error& errorMsg)
+    {
+        _err = errorMsg.what();
+        _state = state::failed;
+        return false;
+    }
+}
+
+bool jstream_parser::done() const
+{
+    return _state == state::done;
+}
+
+json& jstream_parser::result()
+{
+    return _result;
+}
+
+const std::string& jstream_parser::error() const
+{
+    return _err;
+}
+
+void jstream_parser::reset()
+{
+    _state = state::value;
+    _is_key = false;
+    _nesting.clear();
+    _obj.clear();
+    _arr.clear();
+    _keys.clear();
+    _buf.clear();
+    _tok.clear();
+    _high_surrogate = 0;
+    _offset = 0;
+    _result = nullptr;
+    _err.clear();
+}
+
+void jstream_parser::begin_value(char c)
+{
+    switch (c)
+    {
+    case '{':
+        _nesting.push_back('{');
+        _obj.emplace_back();
+        _state = state::object_first;
+        break;
+    case '[':
+        _nesting.push_back('[');
+        _arr.emplace_back();
+        _state = state::array_first;
+        break;
+    case '\"':
+        _buf.clear();
+        _is_key = false;
+        _state = state::string;
+        break;
+    case 't': case 'f': case 'n':
+        _tok.assign(1, c);
+        _state = state::literal;
+        break;
+    default:
+        if (isdigit(c) || c == '-')
+        {
+            _tok.assign(1, c);
+            _state = state::number;
+            break;
+        }
+        throw std::runtime_error(("Unexpected character at position ") + std::to_string(_offset));
+    }
+}
+
+void jstream_parser::end_value(json&& v)
+{
+    if (_nesting.empty())
+    {
+        _result = std::move(v);
+        _state = state::done;
+        return;
+    }
+    if (_nesting.back() == '[')
+    {
+        _arr.back().push_back(std::move(v));
+    }
+    else
+    {
+        _obj.back().emplace(std::move(_keys.back()), std::move(v));
+        _keys.pop_back();
+    }
+    _state = state::after_value;
+}
+
+void jstream_parser::end_string()
+{
+    if (!_is_key)
+    {
+        end_value(json(std::move(_buf)));
+        _buf.clear();
+        return;
+    }
+    if (_obj.back().find(_buf) != _obj.back().end())
+    {
+        throw std::runtime_error(("Duplicated key at position ") + std::to_string(_offset - _buf.size()));
+    }
+    _keys.push_back(std::move(_buf));
+    _buf.clear();
+    _state = state::colon;
+}
+
+void jstream_parser::end_unicode()
+{
+    uint32_t unit;
+    if (!jutf8::read_hex4(_tok.data(), unit))
+    {
+        throw std::runtime_error("Expected 4 hexadecimal digit sequence at position " + std::to_string(_offset - 3));
+    }
+    _state = state::string;
+    if (_high_surrogate != 0)
+    {
+        if (!jutf8::is_low_surrogate(unit))
+        {
+            throw std::runtime_error("Bad utf-16 code point at position " + std::to_string(_offset - 3));
+        }
+        jutf8::append(jutf8::combine(_high_surrogate, unit), _buf);
+        _high_surrogate = 0;
+    }
+    else if (jutf8::is_high_surrogate(unit))
+    {
+        _high_surrogate = unit;
+    }
+    else
+    {
+        jutf8::append(unit, _buf);
+    }
+}
+
+/*
+ * The number grammar is the one of `jparser::parse_number`.
+ */
+void jstream_parser::end_number()
+{
+    jparser parser(_tok, nullptr);
+    json v = parser.parse_number();
+    if (parser.failure || parser.p != parser.e)
+    {
+        throw std::runtime_error(("Bad number at position ") + std::to_string(_offset - _tok.size()));
+    }
+    end_value(std::move(v));
+}
+
+void jstream_parser::end_literal()
+{
+    if (_tok == "true")
+    {
+        end_value(true);
+    }
+    else if (_tok == "false")
+    {
+        end_value(false);
+    }
+    else if (_tok == "null")
+    {
+        end_value(json());
+    }
+    else
+    {
+        throw std::runtime_error(("Expected `true`, `false` or `null` at position ") + std::to_string(_offset - _tok.size()));
+    }
+}
+
+void jstream_parser::close(char c)
+{
+    _nesting.pop_back();
+    if (c == '}')
+    {
+        json v(std::move(_obj.back()));
+        _obj.pop_back();
+        end_value(std::move(v));
+    }
+    else
+    {
+        json v(std::move(_arr.back()));
+        _arr.pop_back();
+        end_value(std::move(v));
+    }
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "json.h"
+#include <string_view>
+#include <vector>
+namespace mq
+{
+
+/*
+ * A push parser: the document is handed over in pieces of any size with
+ * `feed`, and `finish` marks the end of the input. Only the value being
+ * built and a stack as deep as the nesting are kept between calls, the
+ * input itself is never buffered. Like `jparser::parse`, anything after
+ * the first complete value is ignored.
+ */
+class jstream_parser
+{
+public:
+    jstream_parser();
+
+    bool feed(const char* data, size_t len);
+    bool feed(std::string_view data);
+    bool finish();
+
+    bool done() const;
+    json& result();
+    const std::string& error() const;
+    void reset();
+private:
+    enum class state
+    {
+        value, array_first, object_first, key, colon, after_value,
+        string, escape, unicode, number, literal, done, failed
+    };
+
+    void begin_value(char c);
+    void end_value(json&& v);
+    void end_string();
+    void end_unicode();
+    void end_number();
+    void end_literal();
+    void close(char c);
+
+    state _state;
+    bool _is_key;
+    std::vector<char> _nesting;
+    std::vector<json::object> _obj;
+    std::vector<json::array> _arr;
+    std::vector<std::string> _keys;
+    std::string _buf; //the string being read
+    std::string _tok; //the number, literal or `\u` digits being read
+    uint32_t _high_surrogate;
+    size_t _offset;
+    json _result;
+    std::string _err;
+};
+
+}
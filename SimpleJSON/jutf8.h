@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+namespace mq
+{
+
+struct jhex_table
+{
+    uint8_t v[256];
+    constexpr jhex_table() : v()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            v[i] = 0xff;
+        }
+        for (int i = 0; i < 10; i++)
+        {
+            v['0' + i] = static_cast<uint8_t>(i);
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            v['a' + i] = v['A' + i] = static_cast<uint8_t>(10 + i);
+        }
+    }
+};
+constexpr jhex_table jhex_digits; //0xff for a byte that is not a digit
+
+/*
+ * Helpers shared by the parsers for `\uXXXX` escapes and raw UTF-8.
+ */
+class jutf8
+{
+public:
+    //reads the 4 hexadecimal digits at `p`, false if one is not a digit
+    static bool read_hex4(const char* p, uint32_t& unit)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            uint8_t d = jhex_digits.v[static_cast<unsigned char>(p[i])];
+            if (d == 0xff)
+            {
+                return false;
+            }
+            v = v << 4 | d;
+        }
+        unit = v;
+        return true;
+    }
+
+    static bool is_high_surrogate(uint32_t unit)
+    {
+        return 0xd800 <= unit && unit < 0xdc00;
+    }
+
+    static bool is_low_surrogate(uint32_t unit)
+    {
+        return 0xdc00 <= unit && unit < 0xe000;
+    }
+
+    static uint32_t combine(uint32_t high, uint32_t low)
+    {
+        return 0x10000 + ((high - 0xd800) << 10) + (low - 0xdc00);
+    }
+
+    /*
+     * The length of the UTF-8 sequence starting at `p`, 0 when it is not
+     * well formed: truncated, overlong, a surrogate or above U+10FFFF.
+     */
+    static size_t sequence_length(const char* p, const char* e)
+    {
+        auto byte = [p](size_t i) { return static_cast<unsigned char>(p[i]); };
+        auto continuation = [&](size_t i) { return (byte(i) & 0xc0) == 0x80; };
+        unsigned char lead = byte(0);
+        if (lead < 0x80)
+        {
+            return 1;
+        }
+        if (lead < 0xc2 || lead > 0xf4) //continuation, overlong 2 byte or beyond U+10FFFF
+        {
+            return 0;
+        }
+        size_t n = lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+        if (static_cast<size_t>(e - p) < n)
+        {
+            return 0;
+        }
+        //the second byte has a narrower range after some leads
+        unsigned char lo = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+        unsigned char hi = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+        if (byte(1) < lo || byte(1) > hi)
+        {
+            return 0;
+        }
+        for (size_t i = 2; i < n; i++)
+        {
+            if (!continuation(i))
+            {
+                return 0;
+            }
+        }
+        return n;
+    }
+
+    static void append(uint32_t cp, std::string& s)
+    {
+        if (cp < 0x80)
+        {
+            s += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            char u[] = { static_cast<char>(0xc0 | cp >> 6), static_cast<char>(0x80 | (cp & 0x3f)) };
+            s.append(u, 2);
+        }
+        else if (cp < 0x10000)
+        {
+            char u[] = { static_cast<char>(0xe0 | cp >> 12), static_cast<char>(0x80 | ((cp >> 6) & 0x3f)),
+                         static_cast<char>(0x80 | (cp & 0x3f)) };
+            s.append(u, 3);
+        }
+        else
+        {
+            char u[] = { static_cast<char>(0xf0 | cp >> 18), static_cast<char>(0x80 | ((cp >> 12) & 0x3f)),
+                         static_cast<char>(0x80 | ((cp >> 6) & 0x3f)), static_cast<char>(0x80 | (cp & 0x3f)) };
+            s.append(u, 4);
+        }
+    }
+};
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "json.h"
+#include "jnode_arena.h"
+#include <atomic>
+#include <cassert>
+
+namespace mq
+{
+
+/*
+ * The heap node behind a string, object or array `json`. Scalars never
+ * get a node, they are stored inline in `json`. There is no virtual
+ * function, the concrete class is known from `type()`.
+ */
+class jvalue
+{
+    friend json;
+public:
+    jvalue(const jvalue&) = delete;
+    jvalue& operator=(const jvalue&) = delete;
+    jvalue(jvalue&&) = delete;
+    jvalue& operator=(jvalue&&) = delete;
+
+    json::type type() const
+    {
+        return _type;
+    }
+    const json* find_unsafe(std::string_view key) const;
+    const json& get_value_unsafe(size_t i) const;
+    const std::string& get_string_unsafe() const; //also the text of a number kept as text
+    const json::object& get_object_unsafe() const;
+    const json::array& get_array_unsafe() const;
+
+    jvalue* clone() const;
+    bool equals_to_unsafe(const jvalue* r) const;
+    static void destroy(const jvalue* v);
+    static size_t footprint(const jvalue* v);
+
+    static jvalue* string_instance(const std::string& s);
+    static jvalue* string_instance(std::string&& s);
+    static jvalue* object_instance(const json::object& s);
+    static jvalue* object_instance(json::object&& s);
+    static jvalue* array_instance(const json::array& s);
+    static jvalue* array_instance(json::array&& s);
+    static jvalue* number_instance(std::string_view text);
+
+    //values owned by an arena, see `json::document`
+    static jvalue* string_instance(std::string&& s, jnode_arena& arena);
+    static jvalue* number_instance(std::string_view text, jnode_arena& arena);
+    static jvalue* object_instance(json::object&& s, jnode_arena& arena);
+    static jvalue* array_instance(json::array&& s, jnode_arena& arena);
+protected:
+    explicit jvalue(json::type t) : _refs(1), _type(t) {}
+    ~jvalue() = default;
+private:
+    std::atomic<uint32_t> _refs;
+    json::type _type;
+};
+
+class jstring : public jvalue
+{
+public:
+    friend class json;
+    friend class jvalue;
+    jstring(const std::string& s) : jvalue(json::STRING), _v(s) {}
+    jstring(std::string&& s) : jvalue(json::STRING), _v(std::move(s)) {}
+    jstring(std::string&& s, json::type t) : jvalue(t), _v(std::move(s)) {} //also holds the text of a number
+    jstring(const std::string& s, json::type t) : jvalue(t), _v(s) {}
+private:
+    std::string _v;
+};
+
+class jobject : public jvalue
+{
+public:
+    friend class json;
+    friend class jvalue;
+    jobject(const json::object& s) : jvalue(json::OBJECT), _v(s) {}
+    jobject(json::object&& s) : jvalue(json::OBJECT), _v(std::move(s)) {}
+private:
+    json::object _v;
+};
+
+class jarray : public jvalue
+{
+public:
+    friend class json;
+    friend class jvalue;
+    jarray(const json::array& s) : jvalue(json::ARRAY), _v(s) {}
+    jarray(json::array&& s) : jvalue(json::ARRAY), _v(std::move(s)) {}
+private:
+    json::array _v;
+};
+
+}
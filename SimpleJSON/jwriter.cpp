@@ -0,0 +1,212 @@
+#include "jwriter.h"
+#include "jvalue.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+namespace mq
+{
+
+namespace
+{
+/*
+ * The character to put after `\` for every byte that must be escaped,
+ * 'u' means the byte is written as `\u00XX`, 0 means copy it as is.
+ */
+const char escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '\"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+const char hex_digits[] = "0123456789abcdef";
+}
+
+void jwriter::write(const json& v, std::string& out, bool pretty)
+{
+    jwriter writer(out, pretty);
+    writer.write_value(v);
+}
+
+jwriter::jwriter(std::string& out, bool pretty)
+    : out(out)
+    , pretty(pretty)
+{
+}
+
+/*
+ * Like `jparser::parse_value`, the writer walks the tree with an explicit
+ * stack instead of recursion, so deeply nested documents can not overflow
+ * the call stack.
+ */
+void jwriter::write_value(const json& root)
+{
+    struct frame
+    {
+        bool is_object;
+        json::object::const_iterator obj_it, obj_end;
+        const json* arr_it;
+        const json* arr_end;
+    };
+    std::vector<frame> stack;
+    auto enter = [&](frame& f) {
+        new_line(stack.size());
+        if (!f.is_object)
+        {
+            return f.arr_it++;
+        }
+        write_string(f.obj_it->first);
+        out.push_back(':');
+        if (pretty)
+        {
+            out.push_back(' ');
+        }
+        return &(f.obj_it++)->second;
+    };
+    const json* v = &root;
+    for (;;)
+    {
+        switch (v->_tag)
+        {
+        case json::tag::object:
+        {
+            auto& obj = v->get()->get_object_unsafe();
+            if (obj.empty())
+            {
+                out.append("{}", 2);
+                break;
+            }
+            out.push_back('{');
+            stack.push_back(frame{true, obj.begin(), obj.end(), nullptr, nullptr});
+            v = enter(stack.back());
+            continue;
+        }
+        case json::tag::array:
+        {
+            auto& arr = v->get()->get_array_unsafe();
+            if (arr.empty())
+            {
+                out.append("[]", 2);
+                break;
+            }
+            out.push_back('[');
+            stack.push_back(frame{false, {}, {}, arr.data(), arr.data() + arr.size()});
+            v = enter(stack.back());
+            continue;
+        }
+        case json::tag::integer:
+            write_int(v->_v.i);
+            break;
+        case json::tag::fraction:
+            write_double(v->_v.d);
+            break;
+        case json::tag::string:
+            write_string(v->get()->get_string_unsafe());
+            break;
+        case json::tag::number_text:
+            out.append(v->get()->get_string_unsafe()); //as it was parsed
+            break;
+        case json::tag::boolean:
+            if (v->_v.b)
+            {
+                out.append("true", 4);
+            }
+            else
+            {
+                out.append("false", 5);
+            }
+            break;
+        case json::tag::null:
+            out.append("null", 4);
+            break;
+        default:
+            assert(0);
+        }
+        for (;;) //value finished, go to next sibling or close the containers
+        {
+            if (stack.empty())
+            {
+                return;
+            }
+            frame& f = stack.back();
+            if (f.is_object ? f.obj_it != f.obj_end : f.arr_it != f.arr_end)
+            {
+                out.push_back(',');
+                v = enter(f);
+                break;
+            }
+            bool is_object = f.is_object;
+            stack.pop_back();
+            new_line(stack.size());
+            out.push_back(is_object ? '}' : ']');
+        }
+    }
+}
+
+void jwriter::write_string(const std::string& s)
+{
+    out.push_back('\"');
+    const char* run = s.data();
+    const char* end = run + s.size();
+    for (const char* p = run; p != end; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        char esc = escape_table[c];
+        if (esc == 0)
+        {
+            continue;
+        }
+        out.append(run, p - run);
+        out.push_back('\\');
+        out.push_back(esc);
+        if (esc == 'u')
+        {
+            out.append("00", 2);
+            out.push_back(hex_digits[c >> 4]);
+            out.push_back(hex_digits[c & 0xf]);
+        }
+        run = p + 1;
+    }
+    out.append(run, end - run);
+    out.push_back('\"');
+}
+
+void jwriter::write_int(int64_t i)
+{
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), i);
+    out.append(buf, res.ptr - buf);
+}
+
+/*
+ * `std::to_chars` gives the shortest representation that round-trips,
+ * and unlike `printf` it never looks at the locale.
+ */
+void jwriter::write_double(double d)
+{
+    if (!std::isfinite(d)) //JSON has no way to represent these
+    {
+        out.append("null", 4);
+        return;
+    }
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), d);
+    out.append(buf, res.ptr - buf);
+    if (std::none_of(buf, res.ptr, [](char c) { return c == '.' || c == 'e'; }))
+    {
+        out.append(".0", 2); //keep it a double when it is parsed back
+    }
+}
+
+void jwriter::new_line(size_t depth)
+{
+    if (pretty)
+    {
+        out.push_back('\n');
+        out.append(depth * 4, ' ');
+    }
+}
+
+}
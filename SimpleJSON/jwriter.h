@@ -0,0 +1,24 @@
+#pragma once
+
+#include "json.h"
+namespace mq
+{
+
+class jwriter
+{
+public:
+    static void write(const json& v, std::string& out, bool pretty);
+private:
+    jwriter(std::string& out, bool pretty);
+
+    void write_value(const json& v);
+    void write_string(const std::string& s);
+    void write_int(int64_t i);
+    void write_double(double d);
+
+    void new_line(size_t depth);
+    std::string& out;
+    bool pretty;
+};
+
+}
@@ -1,8 +1,18 @@
 #define BOOST_TEST_MODULE SimpileJSON Test
 #define BOOST_TEST_DETECT_MEMORY_LEAK 1
 #include <boost/test/included/unit_test.hpp>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <thread>
 #include "json.h"
+#include "jflat_map.h"
+#include "jhandler.h"
+#include "jlazy.h"
 #include "jparser.h"
+#include "jpointer.h"
+#include "jscanner.h"
+#include "jstream_parser.h"
 using namespace mq;
 
 BOOST_AUTO_TEST_CASE(json_ctor_dtor_test)
@@ -194,3 +204,978 @@ BOOST_AUTO_TEST_CASE(json_parser_test)
     BOOST_TEST((_1["arr"][5].is_object()));
     BOOST_TEST((_1["arr"][6].is_array()));
 }
+
+BOOST_AUTO_TEST_CASE(json_dump_test)
+{
+    json doc = json::object{
+        {"int", -12},
+        {"double", 1.5},
+        {"whole", 2.0},
+        {"str", "a\"b\\c\n\x01/"},
+        {"arr", json::array{true, false, json::null, json::array{}, json::object{}}}
+    };
+#ifdef MQ_JSON_FLAT_OBJECT
+    BOOST_TEST(doc.dump() == R"({"int":-12,"double":1.5,"whole":2.0,"str":"a\"b\\c\n\u0001/","arr":[true,false,null,[],{}]})");
+#else
+    BOOST_TEST(doc.dump() == R"({"arr":[true,false,null,[],{}],"double":1.5,"int":-12,"str":"a\"b\\c\n\u0001/","whole":2.0})");
+#endif
+    BOOST_TEST((jparser::parse(doc.dump()) == doc));
+    BOOST_TEST((jparser::parse(doc.dump(true)) == doc));
+
+    BOOST_TEST(json(json::array{1, json::object{{"k", 0.1}}}).dump(true) == "[\n    1,\n    {\n        \"k\": 0.1\n    }\n]");
+
+    std::string out = "prefix:";
+    json(1e26).dump_to(out);
+    BOOST_TEST(out == "prefix:1e+26");
+    BOOST_TEST(json("").dump() == R"("")");
+}
+
+BOOST_AUTO_TEST_CASE(json_document_test)
+{
+    auto doc = json::document::parse(R"({"int" : 1, "str" : "a long string that does not fit in sso", "arr" : [1.5, {"k" : []}]})");
+    auto& root = doc.root();
+    BOOST_TEST((root["int"] == 1));
+    BOOST_TEST((root["str"] == "a long string that does not fit in sso"));
+    BOOST_TEST((root["arr"][0] == 1.5));
+    BOOST_TEST((root["arr"][1]["k"].is_array()));
+
+    json copy = root;
+    copy["int"] = 2; //writing clones the object out of the arena
+    BOOST_TEST((copy["int"] == 2));
+    BOOST_TEST((root["int"] == 1));
+
+    std::string err;
+    BOOST_TEST(!jparser::parse("[1, 2", doc, err));
+    BOOST_TEST(err != "");
+    BOOST_TEST(doc.root().is_null());
+
+    BOOST_TEST(jparser::parse("[1, 2]", doc, err));
+    BOOST_TEST((doc.root() == json::array{1, 2}));
+
+    json::document moved = std::move(doc);
+    BOOST_TEST((moved.root()[1] == 2));
+
+    //the moved-from document can be parsed into, cleared and assigned again
+    BOOST_TEST(jparser::parse(R"({"k" : "a long string that does not fit in sso"})", doc, err));
+    BOOST_TEST((doc.root()["k"] == "a long string that does not fit in sso"));
+    moved = std::move(doc);
+    doc.clear();
+    BOOST_TEST(doc.root().is_null());
+    jparser parser;
+    BOOST_TEST(parser.read("[3]", doc, err));
+    BOOST_TEST((doc.root()[0] == 3));
+    doc = std::move(moved);
+    BOOST_TEST((doc.root()["k"] == "a long string that does not fit in sso"));
+}
+
+BOOST_AUTO_TEST_CASE(json_value_representation_test)
+{
+    BOOST_TEST(sizeof(json) <= 16);
+
+    json i = int64_t(1) << 40;
+    BOOST_TEST(i.is_number());
+    BOOST_TEST(i.as_int() == int64_t(1) << 40);
+    BOOST_TEST((json(1) == 1.0)); //integer and double compare by value
+    BOOST_TEST((json(1) != 1.5));
+    BOOST_TEST((json(true) != 1));
+
+    json a = json::array{1, 2, "str"};
+    json b = a;
+    b[0] = 5; //copy on write, `a` is untouched
+    b[2] = "changed";
+    BOOST_TEST((a == json::array{1, 2, "str"}));
+    BOOST_TEST((b == json::array{5, 2, "changed"}));
+
+    a = std::move(a[2]); //assign from a value owned by the target itself
+    BOOST_TEST((a == "str"));
+}
+
+BOOST_AUTO_TEST_CASE(json_scanner_test)
+{
+    std::string record = R"({"a\\" : [1, -2.5e3, true, null], "b\"{" : "x\\\"y"})";
+    std::string doc = "[";
+    for (int i = 0; i < 40; i++) //shift quotes and backslashes across the 64 byte blocks
+    {
+        doc += record + std::string(i % 7, ' ') + ",\n";
+    }
+    doc += "0]";
+
+    std::vector<uint32_t> expected;
+    bool in_string = false, escaped = false, in_scalar = false;
+    for (size_t i = 0; i < doc.size(); i++)
+    {
+        char c = doc[i];
+        if (in_string)
+        {
+            if (escaped)
+            {
+                escaped = false;
+            }
+            else if (c == '\\')
+            {
+                escaped = true;
+            }
+            else if (c == '\"')
+            {
+                in_string = false;
+            }
+            continue;
+        }
+        bool scalar = std::string("{}[]:,\" \t\r\n").find(c) == std::string::npos;
+        if ((scalar && !in_scalar) || (!scalar && std::string("{}[]:,\"").find(c) != std::string::npos))
+        {
+            expected.push_back(static_cast<uint32_t>(i));
+        }
+        in_string = c == '\"';
+        in_scalar = scalar;
+    }
+    expected.push_back(static_cast<uint32_t>(doc.size()));
+
+    for (auto use : {jscanner::isa::scalar, jscanner::isa::sse2, jscanner::isa::avx2})
+    {
+        if (!jscanner::supported(use))
+        {
+            continue;
+        }
+        std::vector<uint32_t> tokens;
+        jscanner::index(doc.data(), doc.size(), tokens, use);
+        BOOST_TEST(tokens == expected);
+    }
+
+    auto arr = jparser::parse(doc);
+    BOOST_TEST(arr.as_array().size() == 41);
+    BOOST_TEST((arr[39]["a\\"][1] == -2.5e3));
+    BOOST_TEST((arr[39]["b\"{"] == "x\\\"y"));
+
+    //runs of spaces of every length, across 16 byte blocks
+    std::string spaced = "[";
+    std::string compact = "[";
+    for (int i = 0; i < 40; i++)
+    {
+        spaced += std::string(i, i % 2 ? ' ' : '\t') + "\r\n" + std::to_string(i) + std::string(i, ' ') + (i < 39 ? "," : "]");
+        compact += std::to_string(i) + (i < 39 ? "," : "]");
+    }
+    BOOST_TEST((jparser::parse(spaced) == jparser::parse(compact)));
+    BOOST_TEST(jscanner::find_non_space(spaced.data() + 1, spaced.data() + 1 + 20) == spaced.data() + 3);
+    std::string blank(40, ' ');
+    BOOST_TEST(jscanner::find_non_space(blank.data(), blank.data() + blank.size()) == blank.data() + blank.size());
+}
+
+BOOST_AUTO_TEST_CASE(json_bounded_parse_test)
+{
+    const char buffer[] = "[1, \"ab\", 23]456";
+    auto j = jparser::parse(buffer, 13); //stops before the trailing digits
+    BOOST_TEST((j == json::array{1, "ab", 23}));
+
+    std::string_view view(buffer + 1, 1);
+    BOOST_TEST((jparser::parse(view) == 1));
+    BOOST_TEST((json::parse(buffer + 13, 2) == 45));
+
+    std::string err;
+    jparser::parse(buffer, 7, err); //cut in the middle of the string
+    BOOST_TEST(err != "");
+    err.clear();
+    jparser::parse(std::string_view("tru"), err);
+    BOOST_TEST(err != "");
+    err.clear();
+    jparser::parse(std::string_view("\"\\u00"), err);
+    BOOST_TEST(err != "");
+
+    std::string with_nul("\"a\0b\"", 5); //NUL does not end the input any more
+    BOOST_TEST((jparser::parse(with_nul) == std::string("a\0b", 3)));
+}
+
+BOOST_AUTO_TEST_CASE(json_parse_file_test)
+{
+    const char* path = "simplejson_parse_file_test.json";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << R"({"name" : "file", "values" : [1, 2, 3]})";
+    }
+    auto j = json::parse_file(path);
+    BOOST_TEST((j["name"] == "file"));
+    BOOST_TEST((j["values"][2] == 3));
+
+    auto doc = json::document::parse_file(path);
+    BOOST_TEST((doc.root() == j));
+    std::remove(path);
+
+    std::string err;
+    BOOST_TEST(jparser::parse_file(path, err).is_null());
+    BOOST_TEST(err != "");
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_parser_test)
+{
+    std::string doc = R"({"key" : [1, -2.5e-3, true, false, null, "s\"\u20AC\uD801\uDC37", {}, []], "k2" : {"x" : 10}} trailing)";
+    auto expected = jparser::parse(doc);
+    for (size_t chunk : {1, 2, 3, 7, 64})
+    {
+        jstream_parser parser;
+        for (size_t i = 0; i < doc.size(); i += chunk)
+        {
+            BOOST_TEST(parser.feed(doc.data() + i, std::min(chunk, doc.size() - i)));
+        }
+        BOOST_TEST(parser.finish());
+        BOOST_TEST((parser.result() == expected));
+    }
+
+    jstream_parser parser;
+    BOOST_TEST(parser.feed("12"));
+    BOOST_TEST(!parser.done()); //the number may go on
+    BOOST_TEST(parser.feed("34"));
+    BOOST_TEST(parser.finish());
+    BOOST_TEST((parser.result() == 1234));
+
+    parser.reset();
+    BOOST_TEST(parser.feed("[1, 2"));
+    BOOST_TEST(!parser.finish());
+    BOOST_TEST(parser.error() != "");
+
+    parser.reset();
+    BOOST_TEST(!parser.feed("{\"a\" : 1, \"a\" : 2}"));
+    BOOST_TEST(!parser.feed("{}"));
+}
+
+BOOST_AUTO_TEST_CASE(json_handler_test)
+{
+    struct recorder : jhandler
+    {
+        std::string events;
+        bool on_start_object() override { events += "{"; return true; }
+        bool on_end_object() override { events += "}"; return true; }
+        bool on_start_array() override { events += "["; return true; }
+        bool on_end_array() override { events += "]"; return true; }
+        bool on_key(std::string_view key) override { events.append(key).append(":"); return true; }
+        bool on_string(std::string_view s) override { events.append("'").append(s).append("' "); return true; }
+        bool on_int64(int64_t i) override { events += "i" + std::to_string(i) + " "; return true; }
+        bool on_double(double d) override { events += d == 0.5 ? "d0.5 " : "d? "; return true; }
+        bool on_bool(bool b) override { events += b ? "true " : "false "; return true; }
+        bool on_null() override { events += "null "; return true; }
+    };
+    recorder r;
+    std::string err;
+    BOOST_TEST(jparser::parse(R"({"a" : [1, 0.5, "x\ty", true, false, null, {}, []], "bA" : {"c" : -2}})", r, err));
+    BOOST_TEST(r.events == "{a:[i1 d0.5 'x\ty' true false null {}[]]bA:{c:i-2 }}");
+    BOOST_TEST(err == "");
+
+    struct first_id : jhandler
+    {
+        bool at_id = false;
+        int64_t id = 0;
+        int values = 0;
+        bool on_key(std::string_view key) override { at_id = key == "id"; return true; }
+        bool on_int64(int64_t i) override
+        {
+            ++values;
+            id = i;
+            return !at_id; //stop once the field is read
+        }
+    };
+    first_id f;
+    BOOST_TEST(!jparser::parse(R"([{"n" : 1, "id" : 42, "m" : 3}, {"id" : 43}])", f, err));
+    BOOST_TEST(err == "");
+    BOOST_TEST(f.id == 42);
+    BOOST_TEST(f.values == 2);
+
+    for (auto bad : {"[1, 2", "{\"a\" 1}", "{\"a\" : 1,}", "[1 2]", "{1 : 2}", "\"abc"})
+    {
+        recorder b;
+        err.clear();
+        BOOST_TEST(!jparser::parse(bad, b, err));
+        BOOST_TEST(err != "");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_lazy_document_test)
+{
+    std::string text = R"({"items" : [{"a" : [1, {"b" : "]"}]}, "x\"y", 2.5], "escaped" : true,
+        "meta" : {"name" : "lazy", "id" : 42}, "k\u0065y" : 1, "bad" : [1 2]})";
+    auto doc = jlazy::document::parse(text);
+    BOOST_TEST(doc["meta"]["id"].as_int() == 42);
+    BOOST_TEST(doc["meta"]["name"].as_string() == "lazy");
+    BOOST_TEST(doc["escaped"].as_bool());
+    BOOST_TEST(doc["key"].as_int() == 1);
+    BOOST_TEST(doc["items"][1].as_string() == "x\"y");
+    BOOST_TEST(doc["items"][2].as_double() == 2.5);
+    BOOST_TEST((doc["items"][0].value() == jparser::parse(R"({"a" : [1, {"b" : "]"}]})")));
+    BOOST_TEST(doc["items"].value_type() == json::ARRAY);
+    BOOST_TEST(doc["items"][3].is_null());
+    BOOST_TEST(doc["missing"].is_null());
+    BOOST_TEST(doc["meta"][0].is_null());
+    BOOST_CHECK_THROW(doc["bad"][1], std::runtime_error); //only found once reached
+
+    BOOST_TEST(jlazy::document::parse("").root().is_null());
+    BOOST_TEST(jlazy::document::parse(" [7] ")[0].as_int() == 7);
+    BOOST_CHECK_THROW(jlazy::document::parse("{\"a\" : 1")["b"], std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(json_concurrent_destruction_test)
+{
+    json shared;
+    for (int i = 0; i < 1000; i++)
+    {
+        shared = json::array{ shared, json::object{ { "s", "x" } } }; //deep enough to need the flat deleter
+    }
+    std::vector<std::thread> threads;
+    std::vector<json> copies(8, shared);
+    shared = nullptr;
+    for (auto& copy : copies)
+    {
+        threads.emplace_back([&copy]
+        {
+            for (int round = 0; round < 50; round++)
+            {
+                json own = jparser::parse(R"({"a" : [1, 2, {"b" : ["c"]}], "d" : "e"})");
+                own["a"][2]["b"][0] = copy; //the last reference to `copy` is dropped by any of the threads
+                own = nullptr;
+            }
+            copy = nullptr;
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    BOOST_TEST(copies[0].is_null());
+}
+
+BOOST_AUTO_TEST_CASE(json_background_reclaim_test)
+{
+    BOOST_TEST(json::reclaim_stats().queued == 0);
+    json::reclaim_in_background(1024);
+    auto wait_for_queue = []
+    {
+        for (int i = 0; i < 1000 && json::reclaim_stats().queued != 0; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return json::reclaim_stats();
+    };
+
+    json big = json::array(1000, json::object{ { "key", "value" } });
+    json copy = big;
+    auto before = json::reclaim_stats();
+    big = nullptr;
+    BOOST_TEST(json::reclaim_stats().reclaimed == before.reclaimed); //`copy` still holds it
+    copy = nullptr;
+    auto stats = wait_for_queue();
+    BOOST_TEST(stats.reclaimed >= before.reclaimed + 1); //queued by the last release
+    BOOST_TEST(stats.queued == 0);
+    BOOST_TEST(stats.pending_bytes == 0);
+
+    //a small object holding a big array, only the array is queued
+    json nested = json::object{ { "meta", 1 }, { "records", json::array(1000, json::object{ { "key", "value" } }) } };
+    before = stats;
+    nested = nullptr;
+    stats = wait_for_queue();
+    BOOST_TEST(stats.reclaimed == before.reclaimed + 1);
+    BOOST_TEST(stats.pending_bytes == 0);
+
+    json small = json::array{ 1, 2 };
+    before = stats;
+    small = nullptr; //below the threshold, freed right here
+    stats = wait_for_queue();
+    BOOST_TEST(stats.reclaimed == before.reclaimed);
+    BOOST_TEST(stats.queued == 0);
+    json::reclaim_in_background(0);
+}
+
+BOOST_AUTO_TEST_CASE(json_utf16_escape_test)
+{
+    std::string err;
+    BOOST_TEST(jparser::parse(R"("\ud83d")", err).is_null()); //no low surrogate
+    BOOST_TEST(err != "");
+    BOOST_TEST(jparser::parse(R"("\u00e9")").as_string() == "\xc3\xa9"); //nothing left from the failure
+    BOOST_TEST(jparser::parse(R"("\ud83d\ude00")").as_string() == "\xf0\x9f\x98\x80");
+    for (auto bad : { R"("\u00g0")", R"("\u12")", R"("\ud83dA")", R"("\ud83dx")" })
+    {
+        err.clear();
+        BOOST_TEST(jparser::parse(bad, err).is_null());
+        BOOST_TEST(err != "");
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<int> wrong(8);
+    for (size_t i = 0; i < wrong.size(); i++)
+    {
+        threads.emplace_back([&wrong, i]
+        {
+            for (int round = 0; round < 2000; round++)
+            {
+                auto j = jparser::parse(R"(["\ud83d\ude00", "\ud801\udc37"])");
+                wrong[i] += j[0].as_string() != "\xf0\x9f\x98\x80" || j[1].as_string() != "\xf0\x90\x90\xb7";
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    BOOST_TEST(std::count(wrong.begin(), wrong.end(), 0) == 8);
+}
+
+BOOST_AUTO_TEST_CASE(json_parallel_parse_test)
+{
+    std::string arr = "[";
+    std::string obj = "{";
+    for (int i = 0; i < 20000; i++)
+    {
+        std::string record = R"({"id" : )" + std::to_string(i) + R"(, "tags" : ["a,b", "[c]"], "nested" : {"x" : [1, {"y" : null}]}})";
+        arr += (i ? ",\n" : "") + record;
+        obj += (i ? ", \"k" : "\"k") + std::to_string(i) + "\" : " + record;
+    }
+    arr += "]";
+    obj += "}";
+    std::string err;
+    auto parallel = jparser::parse_parallel(arr, err, 4);
+    BOOST_TEST(err == "");
+    BOOST_TEST(parallel.as_array().size() == 20000);
+    BOOST_TEST((parallel == jparser::parse(arr)));
+    BOOST_TEST((jparser::parse_parallel(obj, err, 4) == jparser::parse(obj)));
+    BOOST_TEST(err == "");
+
+    BOOST_TEST((jparser::parse_parallel("[1, 2]", err, 4) == json::array{ 1, 2 })); //too small to split
+    BOOST_TEST((jparser::parse_parallel(" [] ", err) == json::array{}));
+
+    std::string bad = arr;
+    bad[bad.find("null", bad.size() / 2) + 3] = 'x';
+    BOOST_TEST(jparser::parse_parallel(bad, err, 4).is_null());
+    BOOST_TEST(err != "");
+    err.clear();
+    BOOST_TEST(jparser::parse_parallel(arr.substr(0, arr.size() - 1), err, 4).is_null());
+    BOOST_TEST(err != "");
+    err.clear();
+    std::string dup = obj.substr(0, obj.size() - 1) + R"(, "k1" : 0})";
+    BOOST_TEST(jparser::parse_parallel(dup, err, 4).is_null());
+    std::string sequential_err;
+    jparser::parse(dup, sequential_err);
+    BOOST_TEST(err == sequential_err);
+    BOOST_TEST(err.find("Duplicated key at position ") == 0);
+
+    //a trailing comma gives what `parse` gives, also when the text is cut at it
+    std::string big = "\"" + std::string(1 << 18, 'a') + "\"";
+    for (std::string text : { "[1, " + big + ", ]", "[" + big + ", 1, 2,]", "{\"a\" : " + big + ", }" })
+    {
+        std::string parallel_err;
+        std::string expected_err;
+        json parallel = jparser::parse_parallel(text, parallel_err, 2);
+        BOOST_TEST((parallel == jparser::parse(text, expected_err)));
+        BOOST_TEST(parallel_err == expected_err);
+    }
+    BOOST_TEST(jparser::parse_parallel("[1, " + big + ", ]", err, 2).as_array().size() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(json_ndjson_test)
+{
+    std::string lines;
+    for (int i = 0; i < 30000; i++)
+    {
+        lines += i == 1234 ? R"({"id" : 1234 "msg"})" : R"({"id" : )" + std::to_string(i) + R"(, "msg" : "a\nb"})";
+        lines += i % 100 == 99 ? "\r\n\n" : "\n"; //blank lines are skipped
+    }
+    lines += "[1] 2"; //garbage after the value, no final newline
+    for (unsigned threads : { 1, 4 })
+    {
+        std::vector<jparser::line_error> errors;
+        auto values = jparser::parse_ndjson(lines, errors, threads);
+        BOOST_TEST(values.size() == 30001);
+        BOOST_TEST(values[29999]["id"].as_int() == 29999);
+        BOOST_TEST(values[1234].is_null());
+        BOOST_TEST(errors.size() == 2);
+        BOOST_TEST(errors[0].line == 1247); //1234 records and 12 blank lines before it
+        BOOST_TEST(errors[1].line == 30301);
+    }
+
+    size_t seen = 0;
+    size_t last_line = 0;
+    bool ordered = true;
+    BOOST_TEST(!jparser::parse_ndjson(lines, [&](size_t line, json&& value, const std::string& err)
+    {
+        ordered = ordered && line > last_line && (err != "" || value["msg"] == "a\nb");
+        last_line = line;
+        return ++seen < 20000;
+    }, 4));
+    BOOST_TEST(ordered);
+    BOOST_TEST(seen == 20000);
+
+    std::vector<jparser::line_error> errors;
+    BOOST_TEST(jparser::parse_ndjson("", errors).empty());
+    BOOST_TEST(jparser::parse_ndjson("1\n\n2\n", errors).size() == 2);
+    BOOST_TEST(errors.empty());
+}
+
+BOOST_AUTO_TEST_CASE(json_trailing_comma_test)
+{
+    BOOST_TEST((jparser::parse("[1,]") == json::array{ 1, nullptr })); //a missing value is null
+    BOOST_TEST((jparser::parse(R"({"a" : })") == json::object{ { "a", nullptr } }));
+    auto r = jparser::try_parse(R"({"a" : 1,})"); //but a missing key is an error
+    BOOST_TEST(r.err.code == jparser::error::expected_string);
+    BOOST_TEST(r.err.offset == 9);
+    r = jparser::try_parse(R"({"a" : 1, })");
+    BOOST_TEST(r.err.code == jparser::error::expected_string);
+    BOOST_TEST(r.err.offset == 10);
+}
+
+BOOST_AUTO_TEST_CASE(json_flat_map_test)
+{
+    jflat_map<int> m{ { "b", 2 }, { "a", 1 }, { "b", 3 } }; //the first of equal keys is kept
+    BOOST_TEST(m.size() == 2);
+    BOOST_TEST((m.begin()->first == "b"));
+    BOOST_TEST(m.at("b") == 2);
+    BOOST_TEST((m.find("c") == m.end()));
+    m["c"] = 4;
+    BOOST_TEST(m.emplace("c", 5).second == false);
+    BOOST_TEST(m.emplace("0", 0).second);
+    std::string keys;
+    for (auto& member : m)
+    {
+        keys += member.first;
+    }
+    BOOST_TEST(keys == "bac0"); //insertion order
+    BOOST_TEST(m.erase("a") == 1);
+    BOOST_TEST(m.count("a") == 0);
+    BOOST_TEST(m.at("0") == 0);
+
+    jflat_map<int> wide; //past the linear search
+    for (int i = 0; i < 1000; i++)
+    {
+        wide["k" + std::to_string(i)] = i;
+    }
+    bool found = true;
+    for (int i = 0; i < 1000; i++)
+    {
+        found = found && wide.at("k" + std::to_string(i)) == i;
+    }
+    BOOST_TEST(found);
+    BOOST_TEST((wide.find("k1000") == wide.end()));
+    size_t capacity = wide.capacity();
+    wide.erase("k10");
+    BOOST_TEST(wide.count("k10") == 0);
+    BOOST_TEST(wide.at("k999") == 999);
+    for (int i = 0; i < 1000; i += 3)
+    {
+        wide.erase("k" + std::to_string(i));
+    }
+    BOOST_TEST(wide.capacity() == capacity); //members move down in the same buffer
+    BOOST_TEST(wide.size() == 665);
+    BOOST_TEST(wide.at("k998") == 998);
+    BOOST_TEST(wide.count("k999") == 0);
+    BOOST_TEST((std::next(wide.begin())->first == "k2"));
+
+    jflat_map<int> other{ { "c", 9 }, { "d", 5 } };
+    m.merge(other);
+    BOOST_TEST(m.size() == 4);
+    BOOST_TEST(m["c"] == 4);
+    BOOST_TEST(other.size() == 1); //the key already in `m` stays
+    BOOST_TEST((m == jflat_map<int>{ { "d", 5 }, { "0", 0 }, { "b", 2 }, { "c", 4 } })); //in any order
+    BOOST_TEST((m != jflat_map<int>{ { "d", 5 }, { "0", 0 }, { "b", 2 }, { "c", 3 } }));
+
+    //keys can not be changed through an iterator, as with `std::map`
+    static_assert(std::is_const<jflat_map<int>::value_type::first_type>::value, "const keys");
+    static_assert(std::is_const<std::remove_reference_t<decltype(wide.find("k1")->first)>>::value, "const keys");
+    jflat_map<int> copy;
+    copy["x"] = 1;
+    copy = wide;
+    BOOST_TEST((copy == wide));
+    BOOST_TEST(copy.count("x") == 0);
+    BOOST_TEST(copy.at("k500") == 500);
+}
+
+BOOST_AUTO_TEST_CASE(json_key_intern_test)
+{
+    jkey_table table;
+    jkey a = table.intern("a_key_longer_than_small_strings");
+    jkey b = table.intern(std::string("a_key_longer_than_small_strings"));
+    BOOST_TEST(&a.str() == &b.str()); //one shared string
+    BOOST_TEST(table.intern("other").str() == "other");
+    BOOST_TEST(table.size() == 2);
+    for (int i = 0; i < 100; i++)
+    {
+        table.intern("k" + std::to_string(i));
+    }
+    BOOST_TEST(table.size() == 102);
+    BOOST_TEST(&table.intern("k42").str() == &table.intern("k42").str());
+    BOOST_TEST((jkey("x") == table.intern("x")));
+
+    jkey_table capped(2);
+    jkey c = capped.intern("a_key_longer_than_small_strings");
+    capped.intern("other");
+    jkey d = capped.intern("third_key_longer_than_small_strings");
+    BOOST_TEST(capped.size() == 2); //full, `d` is not kept
+    BOOST_TEST(d.str() == "third_key_longer_than_small_strings");
+    BOOST_TEST(&capped.intern("third_key_longer_than_small_strings").str() != &d.str());
+    BOOST_TEST(&capped.intern("a_key_longer_than_small_strings").str() == &c.str());
+    capped.clear();
+    BOOST_TEST(capped.size() == 0);
+    BOOST_TEST(c.str() == "a_key_longer_than_small_strings"); //handed out keys outlive the table entries
+
+#ifdef MQ_JSON_FLAT_OBJECT
+    auto records = jparser::parse(R"([{"a_key_longer_than_small_strings" : 1}, {"a_key_longer_than_small_strings" : 2}])");
+    const std::string& first = records[0].as_object().begin()->first;
+    const std::string& second = records[1].as_object().begin()->first;
+    BOOST_TEST(&first == &second);
+
+    std::string err;
+    auto other = jparser::parse(R"({"a_key_longer_than_small_strings" : 3})", table, err);
+    BOOST_TEST(&other.as_object().begin()->first.str() == &a.str()); //shared with the table
+    BOOST_TEST(other["a_key_longer_than_small_strings"].as_int() == 3);
+
+    jparser parser;
+    parser.intern_keys(false);
+    auto copied = parser.read(R"([{"a_key_longer_than_small_strings" : 1}, {"a_key_longer_than_small_strings" : 2}])", err);
+    BOOST_TEST(&copied[0].as_object().begin()->first.str() != &copied[1].as_object().begin()->first.str());
+    BOOST_TEST(copied[1]["a_key_longer_than_small_strings"].as_int() == 2);
+    parser.intern_keys(true);
+    auto shared = parser.read(R"([{"a_key_longer_than_small_strings" : 1}, {"a_key_longer_than_small_strings" : 2}])", err);
+    BOOST_TEST(&shared[0].as_object().begin()->first.str() == &shared[1].as_object().begin()->first.str());
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(json_string_view_lookup_test)
+{
+    json doc = json::parse(R"({"id" : 7, "name" : "x", "tags" : [1, 2]})");
+    const json& c = doc;
+    std::string_view key = "id";
+    const char* name = "name";
+    BOOST_TEST(c[key].as_int() == 7);
+    BOOST_TEST(c[name].as_string() == "x");
+    BOOST_TEST(c[std::string("tags")][1].as_int() == 2);
+    BOOST_TEST(c["missing"].is_null());
+
+    const json* id = c.find("id");
+    BOOST_TEST((id != nullptr && id->as_int() == 7));
+    BOOST_TEST((c.find("missing") == nullptr));
+    BOOST_TEST((c["tags"].find("id") == nullptr)); //not an object
+
+    doc[std::string_view("id")] = 8; //existing member, no key is built
+    doc[std::string_view("new")] = true;
+    BOOST_TEST(doc["id"].as_int() == 8);
+    BOOST_TEST(doc.find("new")->as_bool());
+    BOOST_TEST(doc.as_object().size() == 4);
+}
+
+BOOST_AUTO_TEST_CASE(json_pointer_test)
+{
+    //the examples of RFC 6901
+    json doc = json::parse(R"({"foo" : ["bar", "baz"], "" : 0, "a/b" : 1, "c%d" : 2, "e^f" : 3,
+        "g|h" : 4, "i\\j" : 5, "k\"l" : 6, " " : 7, "m~n" : 8})");
+    BOOST_TEST((jpointer("").get(doc) == doc));
+    BOOST_TEST((jpointer("/foo").get(doc) == json::parse(R"(["bar", "baz"])")));
+    BOOST_TEST(jpointer("/foo/0").get(doc).as_string() == "bar");
+    BOOST_TEST(jpointer("/").get(doc).as_int() == 0);
+    BOOST_TEST(jpointer("/a~1b").get(doc).as_int() == 1);
+    BOOST_TEST(jpointer("/c%d").get(doc).as_int() == 2);
+    BOOST_TEST(jpointer("/i\\j").get(doc).as_int() == 5);
+    BOOST_TEST(jpointer("/ ").get(doc).as_int() == 7);
+    BOOST_TEST(jpointer("/m~0n").get(doc).as_int() == 8);
+
+    BOOST_TEST((jpointer("/foo/2").resolve(doc) == nullptr));
+    BOOST_TEST((jpointer("/foo/01").resolve(doc) == nullptr)); //leading zero, not an index
+    BOOST_TEST((jpointer("/foo/-").resolve(doc) == nullptr));
+    BOOST_TEST((jpointer("/missing/0").resolve(doc) == nullptr));
+    BOOST_TEST(jpointer("/missing").get(doc).is_null());
+    BOOST_CHECK_THROW(jpointer("foo"), std::runtime_error);
+    BOOST_CHECK_THROW(jpointer("/a~2"), std::runtime_error);
+    BOOST_CHECK_THROW(jpointer("/a~"), std::runtime_error);
+
+    json obj = json::parse(R"({"0" : "key", "list" : [{"1" : true}]})");
+    BOOST_TEST(jpointer("/0").get(obj).as_string() == "key"); //a number is a key in an object
+    BOOST_TEST(jpointer("/list/0/1").get(obj).as_bool());
+
+    //one walk for several pointers sharing prefixes
+    jpointer::set paths({ jpointer("/user/address/zip"), jpointer("/user/address/city"),
+                          jpointer("/user/name"), jpointer("/id"), jpointer("/user/phones/1"),
+                          jpointer("/user/missing/x"), jpointer("/user/address/zip") });
+    BOOST_TEST(paths.size() == 7);
+    std::vector<const json*> found;
+    for (int i = 0; i < 3; i++)
+    {
+        json msg = json::parse(R"({"id" : )" + std::to_string(i) + R"(, "user" : {"name" : "n", "phones" : ["a", "b"],
+            "address" : {"zip" : "z)" + std::to_string(i) + R"(", "city" : "c"}}})");
+        paths.resolve(msg, found);
+        BOOST_TEST(found.size() == 7);
+        BOOST_TEST(found[0]->as_string() == "z" + std::to_string(i));
+        BOOST_TEST(found[1]->as_string() == "c");
+        BOOST_TEST(found[2]->as_string() == "n");
+        BOOST_TEST(found[3]->as_int() == i);
+        BOOST_TEST(found[4]->as_string() == "b");
+        BOOST_TEST((found[5] == nullptr));
+        BOOST_TEST((found[6] == found[0]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_number_exact_test)
+{
+    BOOST_TEST(json::parse("0").as_int() == 0);
+    BOOST_TEST(json::parse("-0").is_number());
+    BOOST_TEST(json::parse("9223372036854775807").as_int() == INT64_MAX);
+    BOOST_TEST(json::parse("-9223372036854775808").as_int() == INT64_MIN);
+    BOOST_TEST(json::parse("9223372036854775808").as_double() == 9223372036854775808.0); //too big for int64_t
+    BOOST_TEST(json::parse("123456789012345678901234567890").as_double() == 1.2345678901234568e29);
+    BOOST_TEST(json::parse("1.5").as_double() == 1.5);
+    BOOST_TEST(json::parse("-2.5e-3").as_double() == -2.5e-3);
+    BOOST_TEST(json::parse("1E22").as_double() == 1e22);
+    BOOST_TEST(json::parse("1e23").as_double() == 1e23);
+    BOOST_TEST(json::parse("0.1").as_double() == 0.1);
+    BOOST_TEST(json::parse("4.9406564584124654e-324").as_double() == 4.9406564584124654e-324);
+    BOOST_TEST(json::parse("1.7976931348623157e308").as_double() == 1.7976931348623157e308);
+    BOOST_TEST(json::parse("2.2250738585072011e-308").as_double() == 2.2250738585072011e-308);
+    BOOST_TEST(json::parse("1e00000000000000000001").as_double() == 10.0);
+    BOOST_TEST(json::parse("0.000000000000000000000000000001").as_double() == 1e-30);
+
+    std::string err;
+    jparser::parse("1e400", err);
+    BOOST_TEST(err.find("Number too big") == 0);
+    for (const char* bad : { "-", "1.", "1e", "1e+", "-a" })
+    {
+        err.clear();
+        jparser::parse(bad, err);
+        BOOST_TEST(!err.empty(), bad);
+    }
+
+    //every double printed with enough digits reads back to the same bits
+    uint64_t state = 88172645463325252ull;
+    for (int i = 0; i < 100000; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double d;
+        uint64_t bits = i % 2 == 0 ? state : (state >> 20) | (uint64_t(1023 + i % 40 - 20) << 52);
+        memcpy(&d, &bits, sizeof(d));
+        if (d != d || d - d != 0) //NaN or infinity
+        {
+            continue;
+        }
+        char buf[64];
+        snprintf(buf, sizeof(buf), i % 3 == 0 ? "%.17g" : "%.15g", d);
+        BOOST_TEST(json::parse(buf).as_double() == strtod(buf, nullptr), buf);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_number_text_test)
+{
+    std::string err;
+    const char* text = R"({"big":123456789012345678901234567890,"half":0.5,"huge":1e400,"id":-9223372036854775809,"pi":3.14159265358979323846264338327950288,"small":12,"tiny":-1e-400})";
+    json doc = jparser::parse(text, jparser::numbers::keep_text, err);
+    BOOST_TEST(err.empty());
+    BOOST_TEST(doc.dump() == text); //nothing lost on the way through
+    BOOST_TEST(doc["big"].is_number());
+    BOOST_TEST(doc["big"].value_type() == json::NUMBER);
+    BOOST_TEST(doc["big"].as_double() == 1.2345678901234568e29);
+    BOOST_TEST(doc["big"].as_int() == INT64_MAX);
+    BOOST_TEST(doc["id"].as_int() == INT64_MIN);
+    BOOST_TEST(doc["pi"].as_double() == 3.141592653589793);
+    BOOST_TEST(doc["pi"].as_int() == 3);
+    BOOST_TEST(doc["small"].as_int() == 12);
+    BOOST_TEST(doc["half"].as_double() == 0.5);
+    BOOST_TEST(std::isinf(doc["huge"].as_double()));
+    BOOST_TEST(doc["tiny"].as_double() == 0.0);
+
+    BOOST_TEST((doc["big"] == 1.2345678901234568e29)); //other numbers compare as doubles
+    json same = jparser::parse("[123456789012345678901234567890, 1234567890123456789012345678900e-1]", jparser::numbers::keep_text, err);
+    BOOST_TEST((same[0] == doc["big"]));
+    BOOST_TEST((same[1] == doc["big"]));
+    json copy = doc;
+    copy["small"] = 13; //copy on write clones the number nodes as well
+    BOOST_TEST((copy["big"] == doc["big"]));
+    BOOST_TEST(copy.dump() != doc.dump());
+
+    BOOST_TEST(jparser::parse("123456789012345678901234567890").is_number()); //a double by default
+    jparser::parse("1e400", err);
+    BOOST_TEST(!err.empty());
+}
+
+BOOST_AUTO_TEST_CASE(json_string_scan_test)
+{
+    //escapes and quotes on every side of the 16 byte blocks
+    for (size_t n = 0; n < 40; n++)
+    {
+        std::string plain(n, 'x');
+        for (size_t at = 0; at <= n; at++)
+        {
+            std::string text = "\"" + plain.substr(0, at) + "\\\"\\\\\\u0041" + plain.substr(at) + "\"";
+            std::string expected = plain.substr(0, at) + "\"\\A" + plain.substr(at);
+            BOOST_TEST(json::parse(text).as_string() == expected);
+            BOOST_TEST(json::parse("{" + text + " : 1}")[expected].as_int() == 1);
+        }
+        BOOST_TEST(json::parse("\"" + plain + "\"").as_string() == plain);
+        std::string err;
+        jparser::parse("\"" + plain, err);
+        BOOST_TEST(!err.empty());
+        err.clear();
+        jparser::parse("\"" + plain + "\\n" + plain, err);
+        BOOST_TEST(!err.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_reused_parser_test)
+{
+    jparser parser;
+    std::string err;
+    for (int i = 0; i < 100; i++)
+    {
+        std::string text = R"({"id" : )" + std::to_string(i) + R"(, "tags" : ["a", "b\n"], "pos" : {"x" : [[1], [2, [3]]]}, "pad" : ")" + std::string(i, 'p') + "\"}";
+        json v = parser.read(text, err);
+        BOOST_TEST(err.empty());
+        BOOST_TEST((v == jparser::parse(text)));
+        if (i % 10 == 0)
+        {
+            BOOST_TEST(parser.read(R"({"id" : [1, {"x" : )", err).is_null()); //leaves its stacks filled
+            BOOST_TEST(!err.empty());
+            err.clear();
+        }
+    }
+
+    json::document doc;
+    for (int i = 0; i < 10; i++)
+    {
+        BOOST_TEST(parser.read(R"({"list" : [1, 2, "three"], "n" : )" + std::to_string(i) + "}", doc, err));
+        BOOST_TEST(doc.root()["n"].as_int() == i);
+        BOOST_TEST(doc.root()["list"][2].as_string() == "three");
+    }
+    BOOST_TEST(!parser.read("[1, 2", doc, err));
+    BOOST_TEST(doc.root().is_null());
+    json plain = parser.read("[1, 2]", err); //not in the document's arena any more
+    doc.clear();
+    BOOST_TEST(plain[1].as_int() == 2);
+
+    jparser keep(jparser::numbers::keep_text);
+    BOOST_TEST(keep.read("123456789012345678901234567890", err).dump() == "123456789012345678901234567890");
+}
+
+BOOST_AUTO_TEST_CASE(json_error_code_test)
+{
+    auto ok = jparser::try_parse(R"({"a" : [1, 2]})");
+    BOOST_TEST(bool(ok));
+    BOOST_TEST(ok.value["a"][1].as_int() == 2);
+
+    std::string text = "{\n  \"a\" : 1,\n  \"b\" : tru\n}";
+    auto bad = jparser::try_parse(text);
+    BOOST_TEST(!bad);
+    BOOST_TEST(bad.value.is_null());
+    BOOST_TEST(bad.err.code == jparser::error::expected_boolean);
+    BOOST_TEST(bad.err.offset == text.find("tru"));
+    BOOST_TEST(bad.err.locate(text).line == 3);
+    BOOST_TEST(bad.err.locate(text).column == 9);
+    std::string err;
+    jparser::parse(text, err);
+    BOOST_TEST(err == bad.err.what());
+    BOOST_TEST(err == "Expected `true` or `false` at position " + std::to_string(bad.err.offset));
+
+    struct
+    {
+        const char* text;
+        jparser::error::code_type code;
+        size_t offset;
+    } cases[] =
+    {
+        { "[1, 2", jparser::error::expected_array_end, 5 },
+        { "{\"a\" 1}", jparser::error::expected_colon, 5 },
+        { "{\"a\" : 1 \"b\"}", jparser::error::expected_object_end, 9 },
+        { "[1 2]", jparser::error::expected_array_end, 3 },
+        { "{1 : 2}", jparser::error::expected_string, 1 },
+        { "[nul]", jparser::error::expected_null, 1 },
+        { "[-]", jparser::error::expected_digit, 2 },
+        { "1e400", jparser::error::number_too_big, 5 },
+        { "{\"a\" : 1, \"a\" : 2}", jparser::error::duplicated_key, 12 },
+        { "\"\\ud800\\u0041\"", jparser::error::bad_utf16, 9 },
+        { "\"\\ud800x\"", jparser::error::expected_utf16_escape, 7 },
+        { "\"\\u12x4\"", jparser::error::expected_hex, 3 },
+        { "[\"abc", jparser::error::unexpected_end, 5 },
+    };
+    jparser parser;
+    for (auto& c : cases)
+    {
+        auto r = jparser::try_parse(c.text);
+        BOOST_TEST(r.err.code == c.code, c.text);
+        BOOST_TEST(r.err.offset == c.offset, c.text);
+        auto again = parser.try_read(c.text); //a reused parser starts clean after an error
+        BOOST_TEST(again.err.code == c.code, c.text);
+        BOOST_TEST(bool(parser.try_read("[true]")));
+    }
+    BOOST_TEST(jparser::error().what() == "No error");
+
+    struct counter : jhandler
+    {
+        int values = 0;
+        bool on_bool(bool) override { ++values; return true; }
+        bool on_string(std::string_view) override { ++values; return true; }
+    } handler;
+    err.clear();
+    BOOST_TEST(!jparser::parse(R"([true, "abc)", handler, err));
+    BOOST_TEST(handler.values == 1); //nothing is reported for the broken string
+    BOOST_TEST(err == "Unexpected end of input");
+}
+
+BOOST_AUTO_TEST_CASE(json_validate_test)
+{
+    std::string wide = "{";
+    for (int i = 0; i < 100; i++)
+    {
+        wide += "\"k" + std::to_string(i) + "\" : {\"k" + std::to_string(i) + "\" : 1}, ";
+    }
+    std::vector<std::string> texts =
+    {
+        "{}", " [ ] ", "0", "-0.5e+3", "-9223372036854775808", "123456789012345678901234567890",
+        "1e400", "1e-400", "[1e308, 1.7976931348623157e309]", "true", "null", "\"\"",
+        "\"caf\xc3\xa9 \\\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"",
+        "\"\\\"\\\\\\/\\b\\f\\n\\r\\t \\x \\u00e9 \\ud83d\\ude00 \\udc00\"",
+        R"({"a" : [1, {"b" : null}, "x"], "c" : {}, "d" : [[]]} )",
+        R"({"a" : {"a" : 1}, "b" : {"a" : 2}})", //the same key in other objects
+        R"({"a" : 1, "a" : 2})", R"({"a\n" : 1, "b" : "\u0062", "a\u000a" : 2})", R"({"a" : 1, "\u0061" : 2})",
+        wide + "\"k50\" : 0}", wide + "\"k100\" : 0}", wide + "\"\\u006b7\" : 0}",
+        "[1,]", "[1, ]", "[,]", R"({"a" : })", "[1] 2", "01", "", "   ", "x", "[x]",
+        "[", "[1", "[1,", "[1, 2", "{", "{ ", R"({"a")", R"({"a" : 1)", R"({"a" : 1,)", R"({"a" : 1, )",
+        R"({"a" 1})", R"({"a" : 1 "b"})", "[1 2]", "{1 : 2}", "[nul]", "[tru]", "[-]", "[1.]", "[1e]", "[01]",
+        "\"\\ud800\\u0041\"", "\"\\ud800x\"", "\"\\u12x4\"", "[\"abc", "\"a\tb\"", "\"\\",
+    };
+    for (auto& text : texts)
+    {
+        auto expected = jparser::try_parse(text).err;
+        auto err = jparser::validate(text);
+        BOOST_TEST(err.code == expected.code, text);
+        BOOST_TEST(err.offset == expected.offset, text);
+    }
+    BOOST_TEST(!jparser::validate("[1,]")); //as lenient as `parse`
+    BOOST_TEST(jparser::validate(R"({"a" : 1, "a" : 2})").code == jparser::error::duplicated_key);
+    BOOST_TEST(jparser::validate("1e400").code == jparser::error::number_too_big);
+
+    //the raw bytes of strings must be valid UTF-8, which `parse` does not check
+    struct
+    {
+        const char* text;
+        size_t offset;
+    } bad_utf8[] =
+    {
+        { "\"\xc0\xaf\"", 1 }, //overlong
+        { "\"\xed\xa0\x80\"", 1 }, //surrogate
+        { "\"\xe2\x82\"", 1 }, //truncated
+        { "\"\xf5\x80\x80\x80\"", 1 }, //beyond U+10FFFF
+        { "\"\\\xc3\"", 2 }, //an escaped lead byte alone
+        { "{\"ab\xff\" : 1}", 4 },
+    };
+    for (auto& c : bad_utf8)
+    {
+        BOOST_TEST(!jparser::try_parse(c.text).err, c.text);
+        auto err = jparser::validate(c.text);
+        BOOST_TEST(err.code == jparser::error::bad_utf8, c.text);
+        BOOST_TEST(err.offset == c.offset, c.text);
+    }
+
+    //deeper than the levels kept without allocation
+    std::string deep = std::string(5000, '[') + std::string(5000, ']');
+    BOOST_TEST(!jparser::validate(deep));
+    deep = std::string(3000, '[') + "{\"a\":" + std::string(3000, '[') + "1" + std::string(3000, ']') + "}" + std::string(3000, ']');
+    BOOST_TEST(!jparser::validate(deep));
+    deep.pop_back();
+    BOOST_TEST(jparser::validate(deep).code == jparser::try_parse(deep).err.code);
+
+    //long strings go through the 16 byte scan
+    std::string text = "[\"" + std::string(100, 'a') + "\xc3\xa9" + std::string(100, 'b') + "\"]";
+    BOOST_TEST(!jparser::validate(text));
+    text[150] = '\xa9';
+    BOOST_TEST(jparser::validate(text).code == jparser::error::bad_utf8);
+    BOOST_TEST(jparser::validate(text).offset == 150);
+}